@@ -1,87 +1,282 @@
 #include "hashtable.h"
+#include "ht_internal.h"
 
 #define XXH_STATIC_LINKING_ONLY /* access advanced declarations */
 #define XXH_IMPLEMENTATION
 #include "xxhash/xxhash.h"
 #include <assert.h>
 
+#define HT_REHASH_STEP 4 // buckets migrated by each operation during an incremental rehash
+#define HT_BATCH_GROUP 16 // lookups whose memory accesses are overlapped by the batch API
+#define HT_SCAN_PREFETCH 8 // buckets or slots ht_foreach requests ahead of the one it visits
+#define HT_MAX_BUCKETS ((size_t)1 << (sizeof(size_t) * 8 - 4)) // largest bucket array, a power of two whose size in bytes fits a size_t
+
+// alignment of a type of the given size, the largest power of two dividing size
+// capped at the strictest fundamental alignment
+static size_t type_align(size_t size) {
+    size_t align = size & (~size + 1);
+    if (align == 0 || align > _Alignof(max_align_t)) {
+        return _Alignof(max_align_t);
+    }
+    return align;
+}
+
+static size_t align_up(size_t x, size_t align) {
+    return (x + align - 1) & ~(align - 1);
+}
+
+// The fixed key entry points read key_size bytes per key, a table with variable
+// length keys has to go through ht_put_bytes and friends. This is checked at run
+// time and not only asserted, -DNDEBUG builds would otherwise hash and compare 0
+// byte keys and run every key into one entry.
+static bool varlen_rejected(const Hashtable *ht, const char *fn) {
+    if (ht->key_size != HT_VARLEN_KEY) {
+        return false;
+    }
+    fprintf(stderr, "%s needs a fixed key_size, use the _bytes or _str functions\n", fn);
+    return true;
+}
+
+// size of one node, rounded so nodes packed in a slab chunk stay aligned
+static size_t ht_node_size(const Hashtable *ht) {
+    if (ht->key_size == HT_VARLEN_KEY) {
+        return align_up(sizeof(HTNode) + ht_str_key_offset(ht) + sizeof(HTStrKey), _Alignof(max_align_t));
+    }
+    return align_up(sizeof(HTNode) + ht->value_offset + ht->value_size, _Alignof(max_align_t));
+}
+
+// bucket count of at least min_cap allowed by the table's capacity policy, 0 when
+// min_cap is above HT_MAX_BUCKETS
+static size_t bucket_capacity(const Hashtable *ht, size_t min_cap) {
+    if (min_cap > HT_MAX_BUCKETS) {
+        return 0;
+    }
+    if (ht->cap_policy == HT_CAP_POW2) {
+        size_t cap = 16;
+        while (cap < min_cap) {
+            cap <<= 1;
+        }
+        return cap;
+    }
+    return next_prime(min_cap);
+}
+
 bool ht_init(Hashtable *ht, size_t key_size, size_t value_size) {
+    return ht_init_with(ht, key_size, value_size, NULL);
+}
+
+// a NULL config gives the defaults, a chained table
+bool ht_init_with(Hashtable *ht, size_t key_size, size_t value_size, const HTConfig *config) {
     if (!ht) {
         fprintf(stderr, "A valid hashtable pointer is required for init\n");
         return false;
     }
-    ht->arr_cap = 17; // prime
+    memset(ht, 0, sizeof(Hashtable));
+    ht->key_size = key_size;
+    ht->value_size = value_size;
+    ht->value_offset = align_up(key_size, type_align(value_size));
+    size_t entry_align = type_align(key_size) > type_align(value_size) ? type_align(key_size) : type_align(value_size);
+    ht->entry_size = align_up(ht->value_offset + value_size, entry_align);
+    ht->backend = config ? config->backend : HT_CHAINED;
+    ht->incremental_rehash = config && config->incremental_rehash;
+    ht->cap_policy = config ? config->cap_policy : HT_CAP_PRIME;
+    ht->hash_kind = config ? config->hash : HT_HASH_XXH3;
+    ht->hash_fn = ht->hash_kind == HT_HASH_CUSTOM ? config->hash_fn : ht_hash_for_kind(ht->hash_kind);
+    if (!ht->hash_fn) {
+        fprintf(stderr, "ht_init requires a hash_fn when the hash kind is HT_HASH_CUSTOM\n");
+        return false;
+    }
+    if (key_size == HT_VARLEN_KEY && ht->backend != HT_CHAINED) {
+        fprintf(stderr, "Variable length keys require the HT_CHAINED backend\n");
+        return false;
+    }
+
+    switch (ht->backend) {
+    case HT_SWISS: return ht_swiss_init(ht, 16);
+    case HT_ROBIN_HOOD: return ht_robin_hood_init(ht, 16);
+    case HT_CHAINED: break;
+    }
+    ht_slab_init(&ht->slab, ht_node_size(ht));
+    ht->arr_cap = bucket_capacity(ht, 16); // 17 for the prime policy
     ht->arr = (HTNode **)malloc(ht->arr_cap * sizeof(HTNode *));
     if (!ht->arr) {
         fprintf(stderr, "Failed to allocate memory for internal hashtable array during ht_init\n");
         return false;
     }
-    ht->count = 0;
-    ht->key_size = key_size;
-    ht->value_size = value_size;
     memset(ht->arr, 0, ht->arr_cap * sizeof(HTNode *)); 
     return true;
 }
 
 Hashtable* _ht_create(size_t key_size, size_t value_size) {
+    return _ht_create_with(key_size, value_size, NULL);
+}
+
+Hashtable* _ht_create_with(size_t key_size, size_t value_size, const HTConfig *config) {
     Hashtable *ht = (Hashtable *)malloc(sizeof(Hashtable));
     if (!ht) {
         fprintf(stderr, "Failed to allocate hashtable during ht_create\n");
-        return false;
+        return NULL;
     }
-    if (!ht_init(ht, key_size, value_size)) {
+    if (!ht_init_with(ht, key_size, value_size, config)) {
         fprintf(stderr, "Failed to call ht_init hashtable during ht_create\n");
-        return false;
+        free(ht);
+        return NULL;
     }
     return ht;
 }
 
+// one slab node holds the node header, the key and the value
 static HTNode* ht_create_node(Hashtable *ht, const void *key, const void *value) {
-    HTNode *new_node = (HTNode *)malloc(sizeof(HTNode));
+    HTNode *new_node = ht_slab_alloc(&ht->slab);
     if (!new_node) {
         fprintf(stderr, "Failed to allocate new HTNode in ht_put\n");
         return NULL;
     }
+    memcpy(ht_node_key(new_node), key, ht->key_size);
+    memcpy(ht_node_value(ht, new_node), value, ht->value_size);
+    new_node->next = NULL;
+    return new_node;
+}
 
-    new_node->key = malloc(ht->key_size);
-    if (!new_node->key) {
-        free(new_node);
-        fprintf(stderr, "Failed to allocate new key during ht_put\n");
-        return NULL;
+// link pointing at the node holding key in the chain starting at head, or NULL
+static HTNode **chain_find(const Hashtable *ht, HTNode **head, const void *key, uint64_t key_hash) {
+    for (HTNode **link = head; *link != NULL; link = &(*link)->next) {
+        HT_COUNT(ht, probes, 1);
+        if (key_hash == (*link)->stored_hash && memcmp(key, ht_node_key(*link), ht->key_size) == 0) {
+            return link;
+        }
+    }
+    return NULL;
+}
+
+// searches the bucket of key_hash and, during an incremental rehash, the
+// bucket of the old array that may not have been migrated yet
+static HTNode **ht_find_link(const Hashtable *ht, const void *key, uint64_t key_hash) {
+    HT_COUNT(ht, lookups, 1);
+    HTNode **link = chain_find(ht, &ht->arr[bucket_index(ht, key_hash, ht->arr_cap)], key, key_hash);
+    if (!link && ht->old_arr) {
+        link = chain_find(ht, &ht->old_arr[bucket_index(ht, key_hash, ht->old_cap)], key, key_hash);
     }
+    return link;
+}
 
-    new_node->value = malloc(ht->value_size);
-    if (!new_node->value) {
-        free(new_node->key);
-        free(new_node);
-        fprintf(stderr, "Failed to allocate new value during ht_put\n");
-        return NULL;
+// moves the chain of old bucket idx into the new array
+static void ht_rehash_bucket(Hashtable *ht, size_t idx) {
+    for (HTNode *node = ht->old_arr[idx], *next; node != NULL; node = next) {
+        next = node->next;
+        size_t bucket_idx = bucket_index(ht, node->stored_hash, ht->arr_cap);
+        node->next = ht->arr[bucket_idx];
+        ht->arr[bucket_idx] = node;
     }
+    ht->old_arr[idx] = NULL;
+}
 
-    memset(new_node->key, 0, ht->key_size);
-    memset(new_node->value, 0, ht->value_size);
-    memcpy(new_node->key, key, ht->key_size);
-    memcpy(new_node->value, value, ht->value_size);
-    new_node->next = NULL;
-    return new_node;
+static void ht_rehash_done(Hashtable *ht) {
+    free(ht->old_arr);
+    ht->old_arr = NULL;
+    ht->old_cap = 0;
+    ht->rehash_idx = 0;
 }
 
-bool ht_put(Hashtable *ht, const void *key, const void *value) {
-    assert(ht); assert(key); assert(value);
+// migrates up to buckets non empty buckets, giving up after visiting ten
+// empty ones per bucket so a sparse old array can't stall a single call
+static void ht_rehash_step(Hashtable *ht, size_t buckets) {
+    size_t empty_visits = buckets * 10;
+    while (buckets > 0 && ht->rehash_idx < ht->old_cap) {
+        if (!ht->old_arr[ht->rehash_idx]) {
+            ht->rehash_idx++;
+            if (--empty_visits == 0) {
+                break;
+            }
+            continue;
+        }
+        ht_rehash_bucket(ht, ht->rehash_idx++);
+        buckets--;
+    }
+    if (ht->rehash_idx == ht->old_cap) {
+        ht_rehash_done(ht);
+    }
+}
+
+static void ht_rehash_finish(Hashtable *ht) {
+    while (ht->rehash_idx < ht->old_cap) {
+        ht_rehash_bucket(ht, ht->rehash_idx++);
+    }
+    ht_rehash_done(ht);
+}
+
+// allocates the new bucket array and leaves the nodes in the old one, they are
+// moved over by later calls to ht_rehash_step
+static bool ht_rehash_start(Hashtable *ht, size_t new_cap) {
+    if (ht->old_arr) {
+        ht_rehash_finish(ht);
+    }
+    size_t new_capacity = bucket_capacity(ht, new_cap);
+    if (new_capacity == 0) {
+        fprintf(stderr, "ht_rehash_start, %zu buckets is above the %zu bucket limit, old ht preserved\n", new_cap, HT_MAX_BUCKETS);
+        return false;
+    }
+    HTNode **new_arr = (HTNode **)calloc(new_capacity, sizeof(HTNode *));
+    if (!new_arr) {
+        fprintf(stderr, "ht_rehash_start, failed to allocate new arr of buckets, old ht preserved\n");
+        return false;
+    }
+    ht->old_arr = ht->arr;
+    ht->old_cap = ht->arr_cap;
+    ht->rehash_idx = 0;
+    ht->arr = new_arr;
+    ht->arr_cap = new_capacity;
+    HT_COUNT(ht, resizes, 1);
+    return true;
+}
+
+// pushes a node at the head of its bucket in the current array
+void ht_link_node(Hashtable *ht, HTNode *node, uint64_t key_hash) {
+    size_t bucket_idx = bucket_index(ht, key_hash, ht->arr_cap);
+    node->stored_hash = key_hash;
+    node->next = ht->arr[bucket_idx];
+    ht->arr[bucket_idx] = node;
+    ht->count++;
+}
+
+// advances a running incremental rehash and grows a chained table about to
+// pass its load factor, before a put links a new node
+static bool ht_make_room(Hashtable *ht) {
+    if (ht->old_arr) {
+        ht_rehash_step(ht, HT_REHASH_STEP);
+    }
     if ((float)ht->count / ht->arr_cap >= 0.75) {
-        if (!ht_resize(ht, 2 * ht->arr_cap)) {
+        bool grown = ht->incremental_rehash ? ht_rehash_start(ht, 2 * ht->arr_cap) : ht_resize(ht, 2 * ht->arr_cap);
+        if (!grown) {
             fprintf(stderr, "Failed call to ht_resize in ht_put\n");
             return false;
         }
     }
+    return true;
+}
+
+bool ht_put(Hashtable *ht, const void *key, const void *value) {
+    assert(ht); assert(key); assert(value);
+    if (varlen_rejected(ht, "ht_put")) {
+        return false;
+    }
+    return ht_put_hashed(ht, key, value, ht_hash(ht, key));
+}
 
-    unsigned int key_hash = hash_func(key, ht->key_size);
-    unsigned int bucket_idx = key_hash % ht->arr_cap;
-    for (HTNode *curr_node = ht->arr[bucket_idx]; curr_node != NULL; curr_node = curr_node->next) {
-        if (key_hash == curr_node->stored_hash && memcmp(key, curr_node->key, ht->key_size) == 0) {
-            memcpy(curr_node->value, value, ht->value_size);
-            return true;
-        }
+bool ht_put_hashed(Hashtable *ht, const void *key, const void *value, uint64_t key_hash) {
+    switch (ht->backend) {
+    case HT_SWISS: return ht_swiss_put(ht, key, value, key_hash);
+    case HT_ROBIN_HOOD: return ht_robin_hood_put(ht, key, value, key_hash);
+    case HT_CHAINED: break;
+    }
+    if (!ht_make_room(ht)) {
+        return false;
+    }
+
+    HTNode **link = ht_find_link(ht, key, key_hash);
+    if (link) {
+        memcpy(ht_node_value(ht, *link), value, ht->value_size);
+        return true;
     }
 
     HTNode *new_node = ht_create_node(ht, key, value);
@@ -89,19 +284,204 @@ bool ht_put(Hashtable *ht, const void *key, const void *value) {
         fprintf(stderr, "Failed to allocate new node in ht_put\n");
         return false;
     }
-    new_node->stored_hash = key_hash;
-    new_node->next = ht->arr[bucket_idx];
-    ht->arr[bucket_idx] = new_node;
-    ht->count++;
+    ht_link_node(ht, new_node, key_hash);
     return true;
 }
 
-bool ht_resize(Hashtable *ht, unsigned int new_cap) {
+// value of key in a chained table, or of a new entry with the key copied in and
+// the value zeroed
+static void *chained_get_or_insert(Hashtable *ht, const void *key, uint64_t key_hash, bool *inserted) {
+    if (!ht_make_room(ht)) {
+        return NULL;
+    }
+    HTNode **link = ht_find_link(ht, key, key_hash);
+    if (link) {
+        *inserted = false;
+        return ht_node_value(ht, *link);
+    }
+    HTNode *node = ht_slab_alloc(&ht->slab);
+    if (!node) {
+        fprintf(stderr, "Failed to allocate new HTNode in ht_get_or_insert\n");
+        return NULL;
+    }
+    memcpy(ht_node_key(node), key, ht->key_size);
+    memset(ht_node_value(ht, node), 0, ht->value_size);
+    ht_link_node(ht, node, key_hash);
+    *inserted = true;
+    return ht_node_value(ht, node);
+}
+
+// Hashes the key once and finds it or the place for it in a single probe, the
+// entry is only created when that probe misses. inserted may be NULL.
+void *ht_get_or_insert(Hashtable *ht, const void *key, bool *inserted) {
+    assert(ht); assert(key);
+    if (varlen_rejected(ht, "ht_get_or_insert")) {
+        return NULL;
+    }
+    return ht_get_or_insert_hashed(ht, key, ht_hash(ht, key), inserted);
+}
+
+void *ht_get_or_insert_hashed(Hashtable *ht, const void *key, uint64_t key_hash, bool *inserted) {
+    bool created = false;
+    void *value = NULL;
+    switch (ht->backend) {
+    case HT_SWISS: value = ht_swiss_get_or_insert(ht, key, key_hash, &created); break;
+    case HT_ROBIN_HOOD: value = ht_robin_hood_get_or_insert(ht, key, key_hash, &created); break;
+    case HT_CHAINED: value = chained_get_or_insert(ht, key, key_hash, &created); break;
+    }
+    if (inserted) {
+        *inserted = created;
+    }
+    return value;
+}
+
+bool ht_upsert(Hashtable *ht, const void *key, HTUpsertFunc fn, void *ctx) {
+    assert(ht); assert(key); assert(fn);
+    if (varlen_rejected(ht, "ht_upsert")) {
+        return false;
+    }
+    bool inserted;
+    void *value = ht_get_or_insert(ht, key, &inserted);
+    if (!value) {
+        return false;
+    }
+    fn(value, inserted, ctx);
+    return true;
+}
+
+// makes room for n entries in total so that many puts trigger no resize
+bool ht_reserve(Hashtable *ht, size_t n) {
+    assert(ht);
+    // no table holds more entries than buckets, and the headroom below cannot overflow
+    if (n > HT_MAX_BUCKETS) {
+        fprintf(stderr, "ht_reserve, %zu entries is above the %zu bucket limit\n", n, HT_MAX_BUCKETS);
+        return false;
+    }
+    switch (ht->backend) {
+    case HT_SWISS:
+    case HT_ROBIN_HOOD:
+        // both keep at most 7/8 of their slots in use
+        if (n + n / 7 < ht->arr_cap) {
+            return true;
+        }
+        return ht_resize(ht, n + n / 7 + 1);
+    case HT_CHAINED: break;
+    }
+    if (ht->old_arr) {
+        ht_rehash_finish(ht);
+    }
+    size_t needed = n + n / 3 + 1; // keeps n / arr_cap below the 0.75 growth threshold
+    if (needed <= ht->arr_cap) {
+        return true;
+    }
+    return ht_resize(ht, needed);
+}
+
+// inserts n keys and values packed key_size and value_size bytes apart, as if
+// by n calls to ht_put. The table is sized once up front, keys are hashed and
+// their buckets prefetched in groups, and new chained nodes are carved from a
+// single contiguous run of the slab.
+bool ht_put_batch(Hashtable *ht, const void *keys, const void *values, size_t n) {
+    assert(ht); assert(keys); assert(values);
+    if (varlen_rejected(ht, "ht_put_batch")) {
+        return false;
+    }
+    if (!ht_reserve(ht, ht->count + n)) {
+        fprintf(stderr, "Failed to reserve room in ht_put_batch\n");
+        return false;
+    }
+    const unsigned char *key_bytes = keys;
+    const unsigned char *value_bytes = values;
+    uint64_t hashes[HT_BATCH_GROUP];
+
+    if (ht->backend != HT_CHAINED) {
+        for (size_t base = 0; base < n; base += HT_BATCH_GROUP) {
+            size_t group = n - base < HT_BATCH_GROUP ? n - base : HT_BATCH_GROUP;
+            for (size_t i = 0; i < group; i++) {
+                hashes[i] = ht_hash(ht, key_bytes + (base + i) * ht->key_size);
+                if (ht->backend == HT_SWISS) {
+                    ht_swiss_prefetch(ht, hashes[i]);
+                } else {
+                    ht_robin_hood_prefetch(ht, hashes[i]);
+                }
+            }
+            for (size_t i = 0; i < group; i++) {
+                const void *key = key_bytes + (base + i) * ht->key_size;
+                const void *value = value_bytes + (base + i) * ht->value_size;
+                bool ok = ht->backend == HT_SWISS ? ht_swiss_put(ht, key, value, hashes[i])
+                                                  : ht_robin_hood_put(ht, key, value, hashes[i]);
+                if (!ok) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    size_t node_size = ht->slab.node_size;
+    unsigned char *block = (unsigned char *)ht_slab_alloc_run(&ht->slab, n);
+    if (!block && n > 0) {
+        fprintf(stderr, "Failed to allocate node block in ht_put_batch\n");
+        return false;
+    }
+    size_t used = 0;
+    for (size_t base = 0; base < n; base += HT_BATCH_GROUP) {
+        size_t group = n - base < HT_BATCH_GROUP ? n - base : HT_BATCH_GROUP;
+        HTNode **heads[HT_BATCH_GROUP];
+        for (size_t i = 0; i < group; i++) {
+            hashes[i] = ht_hash(ht, key_bytes + (base + i) * ht->key_size);
+            heads[i] = &ht->arr[bucket_index(ht, hashes[i], ht->arr_cap)];
+            __builtin_prefetch(heads[i], 1);
+        }
+        for (size_t i = 0; i < group; i++) {
+            if (*heads[i]) {
+                __builtin_prefetch(*heads[i]);
+            }
+        }
+        for (size_t i = 0; i < group; i++) {
+            const void *key = key_bytes + (base + i) * ht->key_size;
+            const void *value = value_bytes + (base + i) * ht->value_size;
+            HT_COUNT(ht, lookups, 1);
+            HTNode **link = chain_find(ht, heads[i], key, hashes[i]);
+            if (link) {
+                memcpy(ht_node_value(ht, *link), value, ht->value_size);
+                continue;
+            }
+            HTNode *node = (HTNode *)(block + used++ * node_size);
+            memcpy(ht_node_key(node), key, ht->key_size);
+            memcpy(ht_node_value(ht, node), value, ht->value_size);
+            ht_link_node(ht, node, hashes[i]);
+        }
+    }
+    // nodes not needed because their key was already present go to the free list
+    for (size_t i = used; i < n; i++) {
+        ht_slab_free(&ht->slab, (HTNode *)(block + i * node_size));
+    }
+    return true;
+}
+
+bool ht_resize(Hashtable *ht, size_t new_cap) {
+    if (new_cap > HT_MAX_BUCKETS) {
+        fprintf(stderr, "ht_resize, %zu buckets is above the %zu bucket limit, old ht preserved\n", new_cap, HT_MAX_BUCKETS);
+        return false;
+    }
+    switch (ht->backend) {
+    case HT_SWISS: return ht_swiss_resize(ht, new_cap);
+    case HT_ROBIN_HOOD: return ht_robin_hood_resize(ht, new_cap);
+    case HT_CHAINED: break;
+    }
+    if (ht->old_arr) {
+        ht_rehash_finish(ht);
+    }
     HTNode** old_arr = ht->arr;
-    unsigned int old_cap = ht->arr_cap;
-    unsigned int new_capacity = next_prime(new_cap);
+    size_t old_cap = ht->arr_cap;
+    size_t new_capacity = bucket_capacity(ht, new_cap);
+    if (new_capacity == 0 || new_capacity > SIZE_MAX / sizeof(HTNode *)) {
+        fprintf(stderr, "ht_resize, %zu buckets is above the %zu bucket limit, old ht preserved\n", new_cap, HT_MAX_BUCKETS);
+        return false;
+    }
     if (new_cap < ht->count) {
-        printf("Warning, resizing hashtable to smaller capacity from %u to %u\n", ht->arr_cap, new_cap );
+        printf("Warning, resizing hashtable to smaller capacity from %zu to %zu\n", ht->arr_cap, new_cap );
     }
 
     ht->arr = (HTNode **)malloc(new_capacity * sizeof(HTNode *));
@@ -112,105 +492,467 @@ bool ht_resize(Hashtable *ht, unsigned int new_cap) {
 
     ht->arr_cap = new_capacity;
     memset(ht->arr, 0, (new_capacity * sizeof(HTNode *)));
-    for (unsigned int i = 0; i < old_cap; i++) {
+    // nodes are redistributed from their cached hash, key memory is never read
+    for (size_t i = 0; i < old_cap; i++) {
         HTNode *ll_head = old_arr[i];
         for (HTNode *node = ll_head, *next; node != NULL; node = next) {
             next = node->next;
-            node->next = NULL;
-            unsigned int bucket_idx = hash_func(node->key, ht->key_size) % new_capacity;
-            if (ht->arr[bucket_idx]) {
-                node->next = ht->arr[bucket_idx];
-            }
+            size_t bucket_idx = bucket_index(ht, node->stored_hash, new_capacity);
+            node->next = ht->arr[bucket_idx];
             ht->arr[bucket_idx] = node;
         }
     }
     free(old_arr);
+    HT_COUNT(ht, resizes, 1);
     return true;
 }
 
 void *ht_find(const Hashtable *ht, const void *key) {
-    unsigned int key_hash = hash_func(key, ht->key_size);
-    unsigned int bucket_idx = key_hash % ht->arr_cap;
-    for (HTNode *curr_node = ht->arr[bucket_idx]; curr_node != NULL; curr_node = curr_node->next) {
-        if (key_hash == curr_node->stored_hash && memcmp(key, curr_node->key, ht->key_size) == 0) {
-            return curr_node->value;
-        }
+    if (varlen_rejected(ht, "ht_find")) {
+        return NULL;
     }
-    return NULL;
+    return ht_find_hashed(ht, key, ht_hash(ht, key));
+}
+
+void *ht_find_hashed(const Hashtable *ht, const void *key, uint64_t key_hash) {
+    switch (ht->backend) {
+    case HT_SWISS: return ht_swiss_find(ht, key, key_hash);
+    case HT_ROBIN_HOOD: return ht_robin_hood_find(ht, key, key_hash);
+    case HT_CHAINED: break;
+    }
+    if (ht->old_arr) {
+        // lookups also advance a running incremental rehash, like puts and deletes
+        ht_rehash_step((Hashtable *)ht, HT_REHASH_STEP);
+    }
+    HTNode **link = ht_find_link(ht, key, key_hash);
+    return link ? ht_node_value(ht, *link) : NULL;
 }
 
 // copies value associated to the key to out_value and returns true if the key is found 
 // otherwise if the key doesn't exist out_value is unchanged and false is returned 
 bool ht_get(const Hashtable *ht, const void *key, void *out_value) {
-    unsigned int key_hash = hash_func(key, ht->key_size);
-    unsigned int bucket_idx = key_hash % ht->arr_cap;
-    for (HTNode *curr_node = ht->arr[bucket_idx]; curr_node != NULL; curr_node = curr_node->next) {
-        if (key_hash == curr_node->stored_hash && memcmp(key, curr_node->key, ht->key_size) == 0) {
-            memcpy(out_value, curr_node->value, ht->value_size);
-            return true;
+    if (varlen_rejected(ht, "ht_get")) {
+        return false;
+    }
+    uint64_t key_hash = ht_hash(ht, key);
+    if (ht->backend != HT_CHAINED) {
+        void *value = ht->backend == HT_SWISS ? ht_swiss_find(ht, key, key_hash) : ht_robin_hood_find(ht, key, key_hash);
+        if (value) {
+            memcpy(out_value, value, ht->value_size);
         }
+        return value != NULL;
+    }
+    if (ht->old_arr) {
+        ht_rehash_step((Hashtable *)ht, HT_REHASH_STEP);
     }
-    return false;
+    HTNode **link = ht_find_link(ht, key, key_hash);
+    if (!link) {
+        return false;
+    }
+    memcpy(out_value, ht_node_value(ht, *link), ht->value_size);
+    return true;
 }
 
 bool ht_contains(const Hashtable *ht, const void *key) {
     return ht_find(ht, key) != NULL;
 }
 
-// internal function freeing memory associated with an HTNode
-static void ht_destroy_node(HTNode *node) {
-    if (!node || !node->key || !node->value) {
-        fprintf(stderr, "node to destroy is NULL or previously destroyed\n");
+// Variable length keys. Nodes have one size and come from the slab like fixed
+// key nodes, with the key kept small string style in an HTStrKey. A chain walk
+// compares the cached 64 bit hash, the length and the 8 byte fingerprint, all
+// inside the node, and only then the rest of the key, which for keys longer
+// than HT_STR_INLINE is the one access to a spilled buffer.
+
+_Static_assert(offsetof(HTStrKey, tail) == offsetof(HTStrKey, head) + sizeof(((HTStrKey *)0)->head),
+               "inline key bytes must be contiguous");
+
+// first 8 key bytes, NUL padded like HTStrKey.head
+static uint64_t str_fingerprint(const void *key, size_t key_len) {
+    uint64_t fingerprint = 0;
+    memcpy(&fingerprint, key, key_len < sizeof(uint64_t) ? key_len : sizeof(uint64_t));
+    return fingerprint;
+}
+
+static HTNode **varlen_chain_find(const Hashtable *ht, HTNode **head, const void *key, size_t key_len,
+                                  uint64_t fingerprint, uint64_t key_hash) {
+    for (HTNode **link = head; *link != NULL; link = &(*link)->next) {
+        HT_COUNT(ht, probes, 1);
+        HTNode *node = *link;
+        HTStrKey *k = ht_str_key(ht, node);
+        uint64_t node_fingerprint;
+        memcpy(&node_fingerprint, k->head, sizeof(uint64_t));
+        if (key_hash == node->stored_hash && k->len == key_len && node_fingerprint == fingerprint
+            && (key_len <= sizeof(uint64_t)
+                || memcmp((const char *)key + sizeof(uint64_t), ht_str_key_bytes(k) + sizeof(uint64_t), key_len - sizeof(uint64_t)) == 0)) {
+            return link;
+        }
+    }
+    return NULL;
+}
+
+static HTNode **varlen_find_link(const Hashtable *ht, const void *key, size_t key_len, uint64_t key_hash) {
+    HT_COUNT(ht, lookups, 1);
+    uint64_t fingerprint = str_fingerprint(key, key_len);
+    HTNode **link = varlen_chain_find(ht, &ht->arr[bucket_index(ht, key_hash, ht->arr_cap)], key, key_len, fingerprint, key_hash);
+    if (!link && ht->old_arr) {
+        link = varlen_chain_find(ht, &ht->old_arr[bucket_index(ht, key_hash, ht->old_cap)], key, key_len, fingerprint, key_hash);
+    }
+    return link;
+}
+
+static bool str_key_store(HTStrKey *k, const void *key, size_t key_len) {
+    memset(k, 0, sizeof(HTStrKey));
+    k->len = (uint32_t)key_len;
+    if (key_len <= HT_STR_INLINE) {
+        memcpy((char *)k + offsetof(HTStrKey, head), key, key_len);
+        return true;
+    }
+    memcpy(k->head, key, sizeof(k->head));
+    char *spill = (char *)malloc(sizeof(uint32_t) + key_len + 1);
+    if (!spill) {
+        return false;
+    }
+    memcpy(spill, &k->len, sizeof(uint32_t));
+    memcpy(spill + sizeof(uint32_t), key, key_len);
+    spill[sizeof(uint32_t) + key_len] = '\0';
+    k->spill = spill + sizeof(uint32_t);
+    return true;
+}
+
+static void str_key_release(HTStrKey *k) {
+    if (k->len > HT_STR_INLINE) {
+        free(k->spill - sizeof(uint32_t));
+    }
+}
+
+static size_t str_key_spill_bytes(const HTStrKey *k) {
+    return k->len > HT_STR_INLINE ? sizeof(uint32_t) + k->len + 1 : 0;
+}
+
+static uint64_t varlen_hash(const Hashtable *ht, const void *key, size_t key_len) {
+    HT_COUNT(ht, hash_calls, 1);
+    return ht->hash_fn(key, key_len);
+}
+
+// node holding key, or a new linked one with the key stored and the value left
+// to the caller. NULL when growing or allocating fails.
+static HTNode *varlen_claim(Hashtable *ht, const void *key, size_t key_len, bool *found) {
+    if (key_len > UINT32_MAX) {
+        fprintf(stderr, "Keys are limited to %u bytes in ht_put_bytes\n", UINT32_MAX);
+        return NULL;
+    }
+    uint64_t key_hash = varlen_hash(ht, key, key_len);
+    if (!ht_make_room(ht)) {
+        return NULL;
+    }
+    HTNode **link = varlen_find_link(ht, key, key_len, key_hash);
+    *found = link != NULL;
+    if (link) {
+        return *link;
+    }
+    HTNode *node = ht_slab_alloc(&ht->slab);
+    if (!node || !str_key_store(ht_str_key(ht, node), key, key_len)) {
+        fprintf(stderr, "Failed to allocate new HTNode in ht_put_bytes\n");
+        if (node) {
+            ht_slab_free(&ht->slab, node);
+        }
+        return NULL;
+    }
+    ht_link_node(ht, node, key_hash);
+    return node;
+}
+
+bool ht_put_bytes(Hashtable *ht, const void *key, size_t key_len, const void *value) {
+    assert(ht); assert(key); assert(value);
+    assert(ht->key_size == HT_VARLEN_KEY);
+    bool found;
+    HTNode *node = varlen_claim(ht, key, key_len, &found);
+    if (!node) {
+        return false;
+    }
+    memcpy(ht_node_value(ht, node), value, ht->value_size);
+    return true;
+}
+
+void *ht_get_or_insert_bytes(Hashtable *ht, const void *key, size_t key_len, bool *inserted) {
+    assert(ht); assert(key);
+    assert(ht->key_size == HT_VARLEN_KEY);
+    bool found;
+    HTNode *node = varlen_claim(ht, key, key_len, &found);
+    if (!node) {
+        return NULL;
+    }
+    if (!found) {
+        memset(ht_node_value(ht, node), 0, ht->value_size);
+    }
+    if (inserted) {
+        *inserted = !found;
+    }
+    return ht_node_value(ht, node);
+}
+
+void *ht_find_bytes(const Hashtable *ht, const void *key, size_t key_len) {
+    assert(ht); assert(key);
+    assert(ht->key_size == HT_VARLEN_KEY);
+    uint64_t key_hash = varlen_hash(ht, key, key_len);
+    if (ht->old_arr) {
+        ht_rehash_step((Hashtable *)ht, HT_REHASH_STEP);
+    }
+    HTNode **link = varlen_find_link(ht, key, key_len, key_hash);
+    return link ? ht_node_value(ht, *link) : NULL;
+}
+
+bool ht_delete_bytes(Hashtable *ht, const void *key, size_t key_len) {
+    assert(ht); assert(key);
+    assert(ht->key_size == HT_VARLEN_KEY);
+    uint64_t key_hash = varlen_hash(ht, key, key_len);
+    if (ht->old_arr) {
+        ht_rehash_step(ht, HT_REHASH_STEP);
+    }
+    HTNode **link = varlen_find_link(ht, key, key_len, key_hash);
+    if (link) {
+        HTNode *node = *link;
+        *link = node->next;
+        str_key_release(ht_str_key(ht, node));
+        ht_slab_free(&ht->slab, node);
+        ht->count--;
+    }
+    return link != NULL;
+}
+
+bool ht_put_str(Hashtable *ht, const char *key, const void *value) {
+    return ht_put_bytes(ht, key, strlen(key), value);
+}
+
+void *ht_get_or_insert_str(Hashtable *ht, const char *key, bool *inserted) {
+    return ht_get_or_insert_bytes(ht, key, strlen(key), inserted);
+}
+
+void *ht_find_str(const Hashtable *ht, const char *key) {
+    return ht_find_bytes(ht, key, strlen(key));
+}
+
+bool ht_get_str(const Hashtable *ht, const char *key, void *out_value) {
+    void *value = ht_find_str(ht, key);
+    if (value) {
+        memcpy(out_value, value, ht->value_size);
+    }
+    return value != NULL;
+}
+
+bool ht_contains_str(const Hashtable *ht, const char *key) {
+    return ht_find_str(ht, key) != NULL;
+}
+
+bool ht_delete_str(Hashtable *ht, const char *key) {
+    return ht_delete_bytes(ht, key, strlen(key));
+}
+
+// the length sits right before the key bytes of a variable length key
+size_t ht_key_len(const Hashtable *ht, const void *key) {
+    if (ht->key_size != HT_VARLEN_KEY) {
+        return ht->key_size;
+    }
+    return ((const uint32_t *)key)[-1];
+}
+
+// frees the spilled keys of a variable length key table, the nodes stay in the slab
+static void varlen_release_chains(const Hashtable *ht, HTNode **arr, size_t cap) {
+    for (size_t i = 0; i < cap; i++) {
+        for (HTNode *node = arr[i]; node != NULL; node = node->next) {
+            str_key_release(ht_str_key(ht, node));
+        }
+    }
+}
+
+// Batched lookups run in groups of HT_BATCH_GROUP keys. All keys of a group are
+// hashed and their buckets (or probe start slots) prefetched first, then the
+// first node of every chain, and only then are the chains walked, so the cache
+// misses of independent lookups overlap instead of being paid one at a time.
+static void ht_find_group(const Hashtable *ht, const unsigned char *keys, size_t n, void **out_values) {
+    uint64_t hashes[HT_BATCH_GROUP];
+    for (size_t i = 0; i < n; i++) {
+        hashes[i] = ht_hash(ht, keys + i * ht->key_size);
+    }
+
+    switch (ht->backend) {
+    case HT_SWISS:
+        for (size_t i = 0; i < n; i++) {
+            ht_swiss_prefetch(ht, hashes[i]);
+        }
+        for (size_t i = 0; i < n; i++) {
+            out_values[i] = ht_swiss_find(ht, keys + i * ht->key_size, hashes[i]);
+        }
+        return;
+    case HT_ROBIN_HOOD:
+        for (size_t i = 0; i < n; i++) {
+            ht_robin_hood_prefetch(ht, hashes[i]);
+        }
+        for (size_t i = 0; i < n; i++) {
+            out_values[i] = ht_robin_hood_find(ht, keys + i * ht->key_size, hashes[i]);
+        }
+        return;
+    case HT_CHAINED: break;
+    }
+
+    HTNode **heads[HT_BATCH_GROUP];
+    for (size_t i = 0; i < n; i++) {
+        heads[i] = &ht->arr[bucket_index(ht, hashes[i], ht->arr_cap)];
+        __builtin_prefetch(heads[i]);
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (*heads[i]) {
+            __builtin_prefetch(*heads[i]);
+        }
+    }
+    for (size_t i = 0; i < n; i++) {
+        const void *key = keys + i * ht->key_size;
+        HT_COUNT(ht, lookups, 1);
+        HTNode **link = chain_find(ht, heads[i], key, hashes[i]);
+        if (!link && ht->old_arr) {
+            link = chain_find(ht, &ht->old_arr[bucket_index(ht, hashes[i], ht->old_cap)], key, hashes[i]);
+        }
+        out_values[i] = link ? ht_node_value(ht, *link) : NULL;
+    }
+}
+
+// keys holds n keys packed key_size bytes apart, out_values[i] receives the
+// value pointer of keys[i] or NULL, returns the number of keys found
+size_t ht_find_batch(const Hashtable *ht, const void *keys, size_t n, void **out_values) {
+    assert(ht); assert(keys); assert(out_values);
+    if (varlen_rejected(ht, "ht_find_batch")) {
+        return 0;
+    }
+    size_t found = 0;
+    for (size_t base = 0; base < n; base += HT_BATCH_GROUP) {
+        size_t group = n - base < HT_BATCH_GROUP ? n - base : HT_BATCH_GROUP;
+        ht_find_group(ht, (const unsigned char *)keys + base * ht->key_size, group, out_values + base);
+        for (size_t i = base; i < base + group; i++) {
+            found += out_values[i] != NULL;
+        }
+    }
+    return found;
+}
+
+// copies the value of each found key to out_values, packed value_size bytes
+// apart, slots of missing keys are left unchanged, out_found may be NULL
+size_t ht_get_batch(const Hashtable *ht, const void *keys, size_t n, void *out_values, bool *out_found) {
+    assert(ht); assert(keys); assert(out_values);
+    if (varlen_rejected(ht, "ht_get_batch")) {
+        return 0;
+    }
+    void *values[HT_BATCH_GROUP];
+    size_t found = 0;
+    for (size_t base = 0; base < n; base += HT_BATCH_GROUP) {
+        size_t group = n - base < HT_BATCH_GROUP ? n - base : HT_BATCH_GROUP;
+        ht_find_group(ht, (const unsigned char *)keys + base * ht->key_size, group, values);
+        for (size_t i = 0; i < group; i++) {
+            if (values[i]) {
+                memcpy((unsigned char *)out_values + (base + i) * ht->value_size, values[i], ht->value_size);
+                found++;
+            }
+            if (out_found) {
+                out_found[base + i] = values[i] != NULL;
+            }
+        }
+    }
+    return found;
+}
+
+size_t ht_contains_batch(const Hashtable *ht, const void *keys, size_t n, bool *out_found) {
+    assert(ht); assert(keys); assert(out_found);
+    if (varlen_rejected(ht, "ht_contains_batch")) {
+        return 0;
+    }
+    void *values[HT_BATCH_GROUP];
+    size_t found = 0;
+    for (size_t base = 0; base < n; base += HT_BATCH_GROUP) {
+        size_t group = n - base < HT_BATCH_GROUP ? n - base : HT_BATCH_GROUP;
+        ht_find_group(ht, (const unsigned char *)keys + base * ht->key_size, group, values);
+        for (size_t i = 0; i < group; i++) {
+            out_found[base + i] = values[i] != NULL;
+            found += values[i] != NULL;
+        }
+    }
+    return found;
+}
+
+// internal function returning an HTNode to the table's slab
+static void ht_destroy_node(Hashtable *ht, HTNode *node) {
+    if (!node) {
+        fprintf(stderr, "node to destroy is NULL\n");
         return;
     }
-    free(node->key);
-    free(node->value);
-    free(node);
-    node->key = NULL;
-    node->value = NULL;
+    ht_slab_free(&ht->slab, node);
 }
 
 
 void ht_delete(Hashtable *ht, const void *key) {
+    if (varlen_rejected(ht, "ht_delete")) {
+        return;
+    }
     if (ht_empty(ht)) {
         fprintf(stderr, "Unable to remove key from empty Hashtable\n");
         return;
     }
-    unsigned int key_hash = hash_func(key, ht->key_size);
-    unsigned int bucket_idx = key_hash % ht->arr_cap;
-    HTNode *prev_node = NULL;
-    HTNode *curr_node = ht->arr[bucket_idx];
-    while (curr_node) {
-        if (curr_node->stored_hash == key_hash && memcmp(key, curr_node->key, ht->key_size) == 0) {
-            if (prev_node) {
-                prev_node->next = curr_node->next;
-            } else { // no prev_node means removing the head so head->next is the new head
-                ht->arr[bucket_idx] = curr_node->next;
-            }
-            ht_destroy_node(curr_node);
-            ht->count--;
-            return;
-        }
-        prev_node = curr_node;
-        curr_node = curr_node->next;
+    ht_delete_hashed(ht, key, ht_hash(ht, key));
+}
+
+// returns whether the key was present
+bool ht_delete_hashed(Hashtable *ht, const void *key, uint64_t key_hash) {
+    switch (ht->backend) {
+    case HT_SWISS: return ht_swiss_delete(ht, key, key_hash);
+    case HT_ROBIN_HOOD: return ht_robin_hood_delete(ht, key, key_hash);
+    case HT_CHAINED: break;
     }
+    if (ht->old_arr) {
+        ht_rehash_step(ht, HT_REHASH_STEP);
+    }
+    HTNode **link = ht_find_link(ht, key, key_hash);
+    if (link) {
+        // unlinking through the link also covers removing a bucket head
+        HTNode *curr_node = *link;
+        *link = curr_node->next;
+        ht_destroy_node(ht, curr_node);
+        ht->count--;
+    }
+    return link != NULL;
 }
 
 void ht_clear(Hashtable *ht) {
-    for (int i = 0; i < ht->arr_cap; i++) {
-        HTNode *curr_node = ht->arr[i];
-        while (curr_node) {
-            HTNode *next_node = curr_node->next;
-            ht_destroy_node(curr_node);
-            curr_node = next_node;
+    switch (ht->backend) {
+    case HT_SWISS: ht_swiss_clear(ht); return;
+    case HT_ROBIN_HOOD: ht_robin_hood_clear(ht); return;
+    case HT_CHAINED: break;
+    }
+    // every node lives in the slab, so the chains need no walking, the
+    // slab rewinds and later puts refill the chunks it already holds. Only
+    // variable length keys are walked, for the keys they spilled.
+    if (ht->key_size == HT_VARLEN_KEY) {
+        varlen_release_chains(ht, ht->arr, ht->arr_cap);
+        if (ht->old_arr) {
+            varlen_release_chains(ht, ht->old_arr + ht->rehash_idx, ht->old_cap - ht->rehash_idx);
         }
-        ht->arr[i] = NULL;
     }
+    memset(ht->arr, 0, ht->arr_cap * sizeof(HTNode *));
+    if (ht->old_arr) {
+        free(ht->old_arr);
+        ht->old_arr = NULL;
+        ht->old_cap = 0;
+        ht->rehash_idx = 0;
+    }
+    ht_slab_reset(&ht->slab);
     ht->count = 0;
 }
 
 void ht_deinit(Hashtable *ht) {
+    switch (ht->backend) {
+    case HT_SWISS: ht_swiss_deinit(ht); return;
+    case HT_ROBIN_HOOD: ht_robin_hood_deinit(ht); return;
+    case HT_CHAINED: break;
+    }
     ht_clear(ht);
+    ht_slab_deinit(&ht->slab);
     free(ht->arr);
     ht->arr = NULL;
 }
@@ -219,10 +961,72 @@ bool ht_empty(const Hashtable *ht) {
     return ht->count == 0;
 }
 
-unsigned int ht_count(const Hashtable *ht) {
+size_t ht_count(const Hashtable *ht) {
     return ht->count;
 }
 
+void ht_stats_record(HTStats *out, size_t len) {
+    out->chain_hist[len < HT_STATS_HIST_LEN ? len : HT_STATS_HIST_LEN - 1]++;
+    if (len > out->max_chain) {
+        out->max_chain = len;
+    }
+}
+
+// walks every bucket, so it costs about as much as a resize. Buckets of the old
+// array not migrated yet by an incremental rehash count as chains too.
+static void ht_chained_stats(const Hashtable *ht, HTStats *out) {
+    size_t empty = 0;
+    size_t spill_bytes = 0;
+    for (size_t i = 0; i < ht->arr_cap; i++) {
+        size_t len = 0;
+        for (HTNode *node = ht->arr[i]; node != NULL; node = node->next) {
+            len++;
+            if (ht->key_size == HT_VARLEN_KEY) {
+                spill_bytes += str_key_spill_bytes(ht_str_key(ht, node));
+            }
+        }
+        empty += len == 0;
+        ht_stats_record(out, len);
+    }
+    size_t old_chains = 0;
+    if (ht->old_arr) {
+        for (size_t i = ht->rehash_idx; i < ht->old_cap; i++) {
+            size_t len = 0;
+            for (HTNode *node = ht->old_arr[i]; node != NULL; node = node->next) {
+                len++;
+                if (ht->key_size == HT_VARLEN_KEY) {
+                    spill_bytes += str_key_spill_bytes(ht_str_key(ht, node));
+                }
+            }
+            if (len > 0) {
+                old_chains++;
+                ht_stats_record(out, len);
+            }
+        }
+    }
+    size_t chains = ht->arr_cap - empty + old_chains;
+    out->empty_ratio = ht->arr_cap ? (double)empty / ht->arr_cap : 0.0;
+    out->mean_chain = chains ? (double)ht->count / chains : 0.0;
+    out->bucket_bytes = (ht->arr_cap + ht->old_cap) * sizeof(HTNode *);
+    out->node_bytes = ht->slab.chunk_bytes + spill_bytes;
+}
+
+void ht_stats(const Hashtable *ht, HTStats *out) {
+    assert(ht); assert(out);
+    memset(out, 0, sizeof(HTStats));
+    out->count = ht->count;
+    out->capacity = ht->arr_cap;
+    out->load_factor = ht->arr_cap ? (double)ht->count / ht->arr_cap : 0.0;
+    out->counters = ht->counters;
+    out->probes_per_lookup = ht->counters.lookups ? (double)ht->counters.probes / ht->counters.lookups : 0.0;
+    switch (ht->backend) {
+    case HT_SWISS: ht_swiss_stats(ht, out); return;
+    case HT_ROBIN_HOOD: ht_robin_hood_stats(ht, out); return;
+    case HT_CHAINED: break;
+    }
+    ht_chained_stats(ht, out);
+}
+
 void _ht_destroy(Hashtable **ht_ptr) {
     if (ht_ptr && *(ht_ptr)) {
         Hashtable *ht = *ht_ptr;
@@ -233,51 +1037,183 @@ void _ht_destroy(Hashtable **ht_ptr) {
 }
 
 
-//TODO: complete the iterator functions init/create, next, restart, destroy
-//TODO: consider wrapping the key, val pair in a new struct type HTEntry and embedding that in each node
-// HTIterator* ht_iterator_init(Hashtable *ht) {
-//     if (!ht) {
-//         fprintf(stderr, "To initialize an iterator you need a valid hashtable pointer\n");
-//         return NULL;
-//     }
+// entries are visited in bucket or slot order, which for open addressing is
+// also address order. A running incremental rehash is finished first so every
+// entry sits in arr and later lookups can't move entries under the iterator.
+bool ht_iterator_init(HTIterator *iter, const Hashtable *ht) {
+    if (!iter || !ht) {
+        fprintf(stderr, "To initialize an iterator you need a valid hashtable pointer\n");
+        return false;
+    }
+    ht_scan_prepare(ht);
+    iter->ht = ht;
+    ht_iterator_restart(iter);
+    return true;
+}
 
-//     HTIterator *iter = malloc(sizeof(HTIterator));
-//     if (!iter) {
-//         fprintf(stderr, "Failed to initialize hashtable iterator\n");
-//         return NULL;
-//     }
+HTIterator *ht_iterator_create(const Hashtable *ht) {
+    HTIterator *iter = (HTIterator *)malloc(sizeof(HTIterator));
+    if (!iter) {
+        fprintf(stderr, "Failed to initialize hashtable iterator\n");
+        return NULL;
+    }
+    if (!ht_iterator_init(iter, ht)) {
+        free(iter);
+        return NULL;
+    }
+    return iter;
+}
 
-// }
+void ht_iterator_restart(HTIterator *iter) {
+    iter->bucket_idx = 0;
+    iter->curr_node = NULL;
+}
 
+// fills out_entry with pointers to the next key and value, false once every
+// entry has been visited. The table must not be modified meanwhile.
+bool ht_iterator_next(HTIterator *iter, HTEntry *out_entry) {
+    const Hashtable *ht = iter->ht;
+    if (ht->backend != HT_CHAINED) {
+        while (iter->bucket_idx < ht->arr_cap) {
+            size_t idx = iter->bucket_idx++;
+            if (ht_slot_full(ht, idx)) {
+                unsigned char *slot = ht_slot_at(ht, idx);
+                out_entry->key = slot;
+                out_entry->value = ht_slot_value(ht, slot);
+                return true;
+            }
+        }
+        return false;
+    }
+    while (!iter->curr_node) {
+        if (iter->bucket_idx >= ht->arr_cap) {
+            return false;
+        }
+        iter->curr_node = ht->arr[iter->bucket_idx++];
+    }
+    HTNode *node = iter->curr_node;
+    iter->curr_node = node->next;
+    out_entry->key = ht_chained_key(ht, node);
+    out_entry->value = ht_node_value(ht, node);
+    return true;
+}
+
+void _ht_iterator_destroy(HTIterator **iter_ptr) {
+    if (iter_ptr && *(iter_ptr)) {
+        free(*iter_ptr);
+        *iter_ptr = NULL;
+    }
+}
+
+// Calls fn on every entry of buckets or slots [lo, hi), in address order. Chained
+// tables have their nodes scattered over the slab, so the first node of the
+// bucket HT_SCAN_PREFETCH ahead is requested while the current chain is walked.
+void ht_foreach_range(const Hashtable *ht, size_t lo, size_t hi, HTForeachFunc fn, void *ctx) {
+    if (ht->backend != HT_CHAINED) {
+        for (size_t i = lo; i < hi; i++) {
+            if (i + HT_SCAN_PREFETCH < hi) {
+                __builtin_prefetch(ht_slot_at(ht, i + HT_SCAN_PREFETCH));
+            }
+            if (ht_slot_full(ht, i)) {
+                unsigned char *slot = ht_slot_at(ht, i);
+                fn(slot, ht_slot_value(ht, slot), ctx);
+            }
+        }
+        return;
+    }
+    for (size_t i = lo; i < hi; i++) {
+        if (i + HT_SCAN_PREFETCH < hi && ht->arr[i + HT_SCAN_PREFETCH]) {
+            __builtin_prefetch(ht->arr[i + HT_SCAN_PREFETCH]);
+        }
+        for (HTNode *node = ht->arr[i]; node != NULL; node = node->next) {
+            fn(ht_chained_key(ht, node), ht_node_value(ht, node), ctx);
+        }
+    }
+}
+
+// whole table scan handing out the hash cached with each entry, for code that
+// stores or rearranges entries by hash without hashing keys again
+void ht_foreach_hashed(const Hashtable *ht, HTHashedFunc fn, void *ctx) {
+    ht_scan_prepare(ht);
+    if (ht->backend != HT_CHAINED) {
+        for (size_t i = 0; i < ht->arr_cap; i++) {
+            if (ht_slot_full(ht, i)) {
+                unsigned char *slot = ht_slot_at(ht, i);
+                fn(ht->hashes[i], slot, ht_slot_value(ht, slot), ctx);
+            }
+        }
+        return;
+    }
+    for (size_t i = 0; i < ht->arr_cap; i++) {
+        for (HTNode *node = ht->arr[i]; node != NULL; node = node->next) {
+            fn(node->stored_hash, ht_chained_key(ht, node), ht_node_value(ht, node), ctx);
+        }
+    }
+}
+
+// makes arr hold every entry so a scan never has to look at old_arr
+void ht_scan_prepare(const Hashtable *ht) {
+    if (ht->old_arr) {
+        ht_rehash_finish((Hashtable *)ht);
+    }
+}
+
+void ht_foreach(const Hashtable *ht, HTForeachFunc fn, void *ctx) {
+    assert(ht); assert(fn);
+    ht_scan_prepare(ht);
+    ht_foreach_range(ht, 0, ht->arr_cap, fn, ctx);
+}
 
-// HTNode* ht_iterator_next(HTIterator *iter) {
-//     HTNode *curr_node = iter->ht->arr[iter->bucket_idx]; // get LL head 
-//     if (!curr_node) {
-//         while (!curr_node) {
-//             curr_node = iter->ht->arr[++iter->bucket_idx];
-//         }
-//     }
-//     if (iter->bucket_idx == iter->ht->arr_cap && !curr_node->next) {
-//         return NULL;
-//     }
-//     iter->curr_node = curr_node->next;
-//     return curr_node;
-// }
 
+uint64_t ht_hash(const Hashtable *ht, const void *key) {
+    assert(ht->key_size != HT_VARLEN_KEY); // those go through ht_put_bytes and friends
+    HT_COUNT(ht, hash_calls, 1);
+    return ht->hash_fn(key, ht->key_size);
+}
+
+static uint64_t xxh3_hash(const void *key, size_t key_size) {
+    return XXH3_64bits(key, key_size);
+}
 
-static unsigned int hash_func(const void *key, size_t key_size) {
-    // return djb2(key, key_size);
+static uint64_t xxh32_hash(const void *key, size_t key_size) {
     return XXH32(key, key_size, 0);
 }
 
+// for integer keys, the key bytes pass through the murmur3 64 bit finalizer
+// which spreads every input bit over the whole hash, longer keys use XXH3
+static uint64_t int_hash(const void *key, size_t key_size) {
+    if (key_size > sizeof(uint64_t)) {
+        return XXH3_64bits(key, key_size);
+    }
+    uint64_t x = 0;
+    memcpy(&x, key, key_size);
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDull;
+    x ^= x >> 33;
+    x *= 0xC4CEB9FE1A85EC53ull;
+    x ^= x >> 33;
+    return x;
+}
+
+HTHashFunc ht_hash_for_kind(HTHashKind kind) {
+    switch (kind) {
+    case HT_HASH_XXH3: return xxh3_hash;
+    case HT_HASH_XXH32: return xxh32_hash;
+    case HT_HASH_DJB2: return djb2;
+    case HT_HASH_INT: return int_hash;
+    case HT_HASH_CUSTOM: break;
+    }
+    return NULL;
+}
+
 inline bool is_even(int x) {
     return x % 2 == 0;
 }
 
-bool is_prime(unsigned int x) {
+bool is_prime(size_t x) {
     if (x <= 1) return false;
     if (x == 2) return true;
-    for (unsigned int i = 3; (i * i <= x); i += 2) {
+    for (size_t i = 3; (i * i <= x); i += 2) {
         if (x % i == 0) {
             return false;
         }
@@ -285,7 +1221,7 @@ bool is_prime(unsigned int x) {
     return true;
 }
 
-unsigned int next_prime(unsigned int x) {
+size_t next_prime(size_t x) {
     if (x <= 2) return 2;
     if (is_even(x)) x++;
     while (!is_prime(x)) {
@@ -294,12 +1230,12 @@ unsigned int next_prime(unsigned int x) {
     return x;
 }
 
-static unsigned int djb2(const void *key, size_t key_size) {
-    unsigned int hash = 5381;
+static uint64_t djb2(const void *key, size_t key_size) {
+    uint64_t hash = 5381;
     const unsigned char *ptr = (unsigned char *)key;
     const unsigned char *end = ptr + key_size;
-    for (int c = *ptr++; ptr < end; c = *ptr++) {
-        hash = ((hash << 5) + hash) + c; /* hash * 33 + c */
+    while (ptr < end) {
+        hash = ((hash << 5) + hash) + *ptr++; /* hash * 33 + c */
     }
     return hash;
 }
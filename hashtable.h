@@ -1,62 +1,259 @@
+#ifndef HASHTABLE_H
+#define HASHTABLE_H
+
 #include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdbool.h>
 #include <string.h>
 
-//TODO: consider abstracting key,val into an entry so 
-// they can be returned with an iterator during iteration
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// pointers to the key and value of an entry inside the table, as returned
+// during iteration
 typedef struct HTEntry {
     void *key;
     void *value;
 } HTEntry;
 
+// key and value bytes are stored inline after the node header so each entry
+// is a single allocation, the key starts at data and the value at value_offset
 typedef struct HTNode {
-    void *key;
-    void *value;
-    unsigned int stored_hash;
+    uint64_t stored_hash;
     struct HTNode *next;
+    max_align_t data[];
 } HTNode;
 
+// storage engine of a table, chosen once at ht_init_with time
+typedef enum HTBackend {
+    HT_CHAINED = 0, // separate chaining through HTNode lists, the default
+    HT_SWISS,       // open addressing with 16 wide SIMD probing of 7 bit control bytes
+    HT_ROBIN_HOOD,  // Robin Hood linear probing with backward shift deletion
+} HTBackend;
+
+// how a chained table picks its bucket count and maps a hash to a bucket
+typedef enum HTCapPolicy {
+    HT_CAP_PRIME = 0, // prime bucket counts and a modulo, forgiving of weak hash functions
+    HT_CAP_POW2,      // power of two bucket counts and a multiply-shift, no division per lookup
+} HTCapPolicy;
+
+// hash function of a table, chosen once at ht_init_with time
+typedef uint64_t (*HTHashFunc)(const void *key, size_t key_size);
+
+typedef enum HTHashKind {
+    HT_HASH_XXH3 = 0, // XXH3_64bits, the default
+    HT_HASH_XXH32,    // XXH32 with seed 0, widened to 64 bits
+    HT_HASH_DJB2,
+    HT_HASH_INT,      // multiply-xorshift mixer for integer keys of up to 8 bytes
+    HT_HASH_CUSTOM,   // HTConfig.hash_fn
+} HTHashKind;
+
+typedef struct HTConfig {
+    HTBackend backend;
+    HTHashKind hash;
+    HTHashFunc hash_fn; // used when hash is HT_HASH_CUSTOM
+    HTCapPolicy cap_policy; // HT_CHAINED only, open addressing backends are always powers of two
+    // HT_CHAINED only, growing allocates the new bucket array and then moves a few
+    // buckets on each put/find/delete instead of moving every node at once
+    bool incremental_rehash;
+} HTConfig;
+
+typedef struct HTSlabChunk {
+    struct HTSlabChunk *next;
+    size_t nodes; // node capacity of data
+    max_align_t data[];
+} HTSlabChunk;
+
+// per table allocator of fixed size nodes, see ht_slab.c
+typedef struct HTSlab {
+    size_t node_size;
+    size_t next_chunk_nodes;
+    size_t chunk_bytes; // total bytes held in chunks
+    HTSlabChunk *chunks;
+    HTSlabChunk *curr; // chunk nodes are being carved from
+    size_t curr_used; // nodes carved from curr so far
+    HTNode *free_list;
+} HTSlab;
+
+// lifetime counters reported by ht_stats, only updated in builds with HT_STATS
+// defined, the fields are always present so the layout doesn't depend on the flag
+typedef struct HTCounters {
+    uint64_t resizes;
+    uint64_t lookups;
+    uint64_t probes;
+    uint64_t hash_calls;
+} HTCounters;
+
 typedef struct Hashtable {
-    unsigned int count;
-    unsigned int arr_cap;
+    size_t count;
+    size_t arr_cap; // number of buckets, or of slots for open addressing backends
     size_t value_size;
     size_t key_size;
+    size_t value_offset; // offset of the value bytes from the start of HTNode.data or of a slot
     HTNode **arr; // array of linked list heads
+    HTBackend backend;
+    HTCapPolicy cap_policy;
+    HTHashKind hash_kind;
+    HTHashFunc hash_fn;
+    // incremental rehash state, while old_arr is set the buckets below rehash_idx
+    // have been moved into arr and the rest still hang off old_arr
+    bool incremental_rehash;
+    HTNode **old_arr;
+    size_t old_cap;
+    size_t rehash_idx;
+    HTSlab slab; // HT_CHAINED node storage
+    // open addressing backends, entries live inline in a flat array of arr_cap slots
+    size_t entry_size; // stride between slots
+    unsigned char *slots;
+    uint64_t *hashes; // hash of the entry in each slot, avoids rehashing keys on resize
+    uint8_t *ctrl; // HT_SWISS control byte per slot, EMPTY, DELETED or the low 7 hash bits,
+                   // HT_ROBIN_HOOD probe distance of the slot plus one, 0 when empty
+    size_t growth_left; // HT_SWISS inserts into empty slots left before a rehash
+    HTCounters counters;
 } Hashtable;
 
+#define HT_STATS_HIST_LEN 16 // the last histogram entry also counts everything longer
+
+// snapshot of a table's shape filled in by ht_stats. For HT_CHAINED a chain is
+// the list of a bucket and chain_hist counts buckets by chain length, empty ones
+// included. For the open addressing backends a chain is the probe sequence of
+// an entry, in slots for HT_ROBIN_HOOD and in 16 slot groups for HT_SWISS, and
+// chain_hist counts entries by how far from home they sit.
+typedef struct HTStats {
+    size_t count;
+    size_t capacity; // buckets or slots
+    double load_factor;
+    double empty_ratio; // empty buckets or slots over capacity
+    size_t max_chain;
+    double mean_chain; // over non empty buckets, or over entries
+    size_t chain_hist[HT_STATS_HIST_LEN];
+    size_t bucket_bytes; // bucket array, or slots with their control bytes and hashes
+    size_t node_bytes; // slab chunks holding the nodes of a chained table, and spilled keys
+    // lifetime counters, all zero unless built with HT_STATS. A probe is a node
+    // walked in a chain, a slot visited by Robin Hood or a group visited by Swiss
+    HTCounters counters;
+    double probes_per_lookup;
+} HTStats;
+
+// key_size of a table whose keys are byte strings of any length, see ht_put_bytes
+// and ht_put_str. HT_CHAINED only.
+#define HT_VARLEN_KEY 0
+
+#define ht_node_key(node) ((void *)(node)->data)
+#define ht_node_value(ht, node) ((void *)((unsigned char *)(node)->data + (ht)->value_offset))
+
 // Utility functions 
-unsigned int next_prime(unsigned int x);
+size_t next_prime(size_t x);
 bool is_even(int x);
-bool is_prime(unsigned int x);
+bool is_prime(size_t x);
 
-static unsigned int djb2(const void *key, size_t key_size);
-static unsigned int hash_func(const void *key, size_t key_size);
+static uint64_t djb2(const void *key, size_t key_size);
 
 bool ht_init(Hashtable *ht, size_t key_size, size_t value_size);
+bool ht_init_with(Hashtable *ht, size_t key_size, size_t value_size, const HTConfig *config);
 Hashtable *_ht_create(size_t key_size, size_t value_size);
+Hashtable *_ht_create_with(size_t key_size, size_t value_size, const HTConfig *config);
 // takes type of key, and type of value
 #define ht_create(key_size, value_size) _ht_create(sizeof(key_size), sizeof(value_size))
+#define ht_create_with(key_size, value_size, config) _ht_create_with(sizeof(key_size), sizeof(value_size), config)
 bool ht_put(Hashtable *ht, const void *key, const void *value);
 static HTNode *ht_create_node(Hashtable *ht, const void *key, const void *value);
-bool ht_resize(Hashtable *ht, unsigned int new_cap);
+bool ht_resize(Hashtable *ht, size_t new_cap);
+bool ht_reserve(Hashtable *ht, size_t n);
+// inserts n keys and values packed key_size and value_size bytes apart
+bool ht_put_batch(Hashtable *ht, const void *keys, const void *values, size_t n);
+// value of key, inserting the key with a zeroed value first when it is absent,
+// with one hash and one probe either way. NULL when the table cannot grow. The
+// pointer is valid until the next put, delete or clear.
+void *ht_get_or_insert(Hashtable *ht, const void *key, bool *inserted);
+// calls fn on the value ht_get_or_insert returns, to update it in place
+typedef void (*HTUpsertFunc)(void *value, bool inserted, void *ctx);
+bool ht_upsert(Hashtable *ht, const void *key, HTUpsertFunc fn, void *ctx);
 
 void ht_deinit(Hashtable *ht);
-static void ht_destroy_node(HTNode *node);
+static void ht_destroy_node(Hashtable *ht, HTNode *node);
 void _ht_destroy(Hashtable **ht);
 #define ht_destroy(ht) _ht_destroy(&ht);
 void ht_delete(Hashtable *ht, const void *key);
 void ht_clear(Hashtable *ht);
 
+uint64_t ht_hash(const Hashtable *ht, const void *key);
 void *ht_find(const Hashtable *ht, const void *key);
 bool ht_get(const Hashtable *ht, const void *key, void *out_value);
 bool ht_contains(const Hashtable *ht, const void *key);
+// batched lookups over n keys packed key_size bytes apart
+size_t ht_find_batch(const Hashtable *ht, const void *keys, size_t n, void **out_values);
+size_t ht_get_batch(const Hashtable *ht, const void *keys, size_t n, void *out_values, bool *out_found);
+size_t ht_contains_batch(const Hashtable *ht, const void *keys, size_t n, bool *out_found);
 bool ht_empty(const Hashtable *ht);
-unsigned int ht_count(const Hashtable *ht);
+size_t ht_count(const Hashtable *ht);
+void ht_stats(const Hashtable *ht, HTStats *out);
+
+
+// Variable length keys, for tables created with key_size HT_VARLEN_KEY. The
+// actual key bytes are hashed. Nodes keep the length and the first bytes of the
+// key, all of a key of up to 19 bytes and the start of a longer one, which is
+// also copied to a buffer of its own. A lookup compares the cached hash, the
+// length and the first 8 bytes before it reads the rest of a key.
+#define ht_create_str(value_type) _ht_create(HT_VARLEN_KEY, sizeof(value_type))
+bool ht_put_bytes(Hashtable *ht, const void *key, size_t key_len, const void *value);
+void *ht_find_bytes(const Hashtable *ht, const void *key, size_t key_len);
+// returns whether the key was present
+bool ht_delete_bytes(Hashtable *ht, const void *key, size_t key_len);
+// NUL terminated keys, the terminator is not part of the key
+bool ht_put_str(Hashtable *ht, const char *key, const void *value);
+void *ht_get_or_insert_bytes(Hashtable *ht, const void *key, size_t key_len, bool *inserted);
+void *ht_get_or_insert_str(Hashtable *ht, const char *key, bool *inserted);
+void *ht_find_str(const Hashtable *ht, const char *key);
+bool ht_get_str(const Hashtable *ht, const char *key, void *out_value);
+bool ht_contains_str(const Hashtable *ht, const char *key);
+bool ht_delete_str(Hashtable *ht, const char *key);
+// length of a key handed out by an iterator or ht_foreach, key_size unless the
+// table has variable length keys. Those are also followed by a NUL.
+size_t ht_key_len(const Hashtable *ht, const void *key);
 
+// Binary snapshots, see ht_snapshot.c. A snapshot keeps the cached hash of
+// every entry, loading sizes the table once and links entries without hashing.
+bool ht_save(const Hashtable *ht, const char *path);
+Hashtable *ht_load(const char *path);
+// loads into another backend or capacity policy, needed for HT_HASH_CUSTOM
+Hashtable *ht_load_with(const char *path, const HTConfig *config);
 
 typedef struct HTIterator {
-    unsigned int bucket_idx;
-    HTNode *curr_node;
+    size_t bucket_idx; // next bucket or slot to visit
+    HTNode *curr_node; // next node of the current chain
     const Hashtable *ht;
 } HTIterator;
+
+bool ht_iterator_init(HTIterator *iter, const Hashtable *ht);
+HTIterator *ht_iterator_create(const Hashtable *ht);
+bool ht_iterator_next(HTIterator *iter, HTEntry *out_entry);
+void ht_iterator_restart(HTIterator *iter);
+void _ht_iterator_destroy(HTIterator **iter);
+#define ht_iterator_destroy(iter) _ht_iterator_destroy(&iter);
+
+typedef void (*HTForeachFunc)(void *key, void *value, void *ctx);
+void ht_foreach(const Hashtable *ht, HTForeachFunc fn, void *ctx);
+
+// Parallel scans split the buckets or slots into one contiguous slice per
+// thread, threads 0 uses one per online CPU. fn and reduce run concurrently on
+// different entries and must not modify the table.
+void ht_parallel_foreach(const Hashtable *ht, HTForeachFunc fn, void *ctx, size_t threads);
+// folds an entry into acc, the calling worker's accumulator
+typedef void (*HTReduceFunc)(void *key, void *value, void *acc, void *ctx);
+// merges the accumulator of one worker into out_acc
+typedef void (*HTCombineFunc)(void *out_acc, const void *worker_acc, void *ctx);
+// every worker starts from a copy of the acc_size bytes at init and reduces its
+// slice, out_acc starts as another copy and the workers are combined into it in
+// slice order on the calling thread
+bool ht_parallel_reduce(const Hashtable *ht, size_t threads, const void *init, size_t acc_size,
+                        HTReduceFunc reduce, HTCombineFunc combine, void *ctx, void *out_acc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HASHTABLE_H
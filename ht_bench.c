@@ -0,0 +1,905 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#include <pthread.h>
+#include "hashtable.h"
+#include "ht_concurrent.h"
+#include "ht_sharded.h"
+#include "ht_frozen.h"
+#include "ht_perfect.h"
+#include "ht_define.h"
+#include "test_cases.h"
+
+#define RESIZE_ENTRIES 200000
+#define RESIZE_REPS 3
+
+static volatile long sink; // keeps benchmarked results alive
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+// hands memory freed by a destroyed table back to the OS, otherwise glibc's
+// heap stays fragmented by millions of freed nodes and slows the next run
+static void release_memory(void) {
+#ifdef __GLIBC__
+    malloc_trim(0);
+#endif
+}
+
+static void fill_random(unsigned char *buf, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = (unsigned char)rand();
+    }
+}
+
+// the previous ht_resize, which hashed every key again, kept as a baseline
+static bool rehashing_resize(Hashtable *ht, size_t new_cap) {
+    size_t new_capacity = next_prime(new_cap);
+    HTNode **new_arr = (HTNode **)calloc(new_capacity, sizeof(HTNode *));
+    if (!new_arr) {
+        fprintf(stderr, "rehashing_resize, failed to allocate new arr of buckets, old ht preserved\n");
+        return false;
+    }
+    for (size_t i = 0; i < ht->arr_cap; i++) {
+        for (HTNode *node = ht->arr[i], *next; node != NULL; node = next) {
+            next = node->next;
+            size_t bucket_idx = ht_hash(ht, ht_node_key(node)) % new_capacity;
+            node->next = new_arr[bucket_idx];
+            new_arr[bucket_idx] = node;
+        }
+    }
+    free(ht->arr);
+    ht->arr = new_arr;
+    ht->arr_cap = new_capacity;
+    return true;
+}
+
+// resizes a table back and forth between two capacities, once redistributing
+// from the cached hashes and once hashing every key again, best of RESIZE_REPS
+static void bench_resize(void) {
+    size_t key_sizes[] = {4, 8, 16, 32, 64, 128, 256};
+    printf("resize of %d entries, best of %d\n", RESIZE_ENTRIES, RESIZE_REPS);
+    printf("%8s %14s %14s %8s\n", "key_size", "cached_ms", "rehash_ms", "speedup");
+    for (size_t k = 0; k < sizeof(key_sizes) / sizeof(key_sizes[0]); k++) {
+        size_t key_size = key_sizes[k];
+        Hashtable *ht = _ht_create(key_size, sizeof(int));
+        unsigned char *key = malloc(key_size);
+        for (int i = 0; i < RESIZE_ENTRIES; i++) {
+            fill_random(key, key_size);
+            memcpy(key, &i, key_size < sizeof(i) ? key_size : sizeof(i));
+            ht_put(ht, key, &i);
+        }
+
+        size_t small_cap = ht->arr_cap;
+        size_t large_cap = 2 * small_cap;
+        double cached = 1e30, rehash = 1e30;
+        for (int rep = 0; rep < RESIZE_REPS; rep++) {
+            double start = now_ms();
+            ht_resize(ht, large_cap);
+            double elapsed = now_ms() - start;
+            cached = elapsed < cached ? elapsed : cached;
+            ht_resize(ht, small_cap);
+
+            start = now_ms();
+            if (!rehashing_resize(ht, large_cap)) {
+                break;
+            }
+            elapsed = now_ms() - start;
+            rehash = elapsed < rehash ? elapsed : rehash;
+            ht_resize(ht, small_cap);
+        }
+        if (rehash < 1e30) {
+            printf("%8zu %14.3f %14.3f %7.2fx\n", key_size, cached, rehash, rehash / cached);
+        }
+        free(key);
+        ht_destroy(ht);
+        release_memory();
+    }
+}
+
+// ht_find throughput on int keys under each capacity policy, the lookups
+// cycle through the inserted keys in a shuffled order
+static void bench_cap_policy(void) {
+    int sizes[] = {1000, 100000, 1000000, 10000000};
+    HTCapPolicy policies[] = {HT_CAP_PRIME, HT_CAP_POW2};
+    const char *names[] = {"prime", "pow2"};
+    printf("ht_find hits by capacity policy\n");
+    printf("%10s %8s %10s\n", "entries", "policy", "ns/op");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        int n = sizes[s];
+        int *order = malloc(n * sizeof(int));
+        for (int i = 0; i < n; i++) {
+            order[i] = i;
+        }
+        for (int i = n - 1; i > 0; i--) {
+            int j = rand() % (i + 1);
+            int tmp = order[i];
+            order[i] = order[j];
+            order[j] = tmp;
+        }
+        for (int p = 0; p < 2; p++) {
+            HTConfig config = { .backend = HT_CHAINED, .cap_policy = policies[p] };
+            Hashtable *ht = ht_create_with(int, int, &config);
+            for (int i = 0; i < n; i++) {
+                ht_put(ht, &i, &i);
+            }
+            long lookups = 10000000;
+            long sum = 0;
+            double start = now_ms();
+            for (long i = 0; i < lookups; i++) {
+                sum += *(int *)ht_find(ht, &order[i % n]);
+            }
+            double elapsed = now_ms() - start;
+            sink = sum;
+            printf("%10d %8s %10.2f\n", n, names[p], elapsed * 1e6 / lookups);
+            ht_destroy(ht);
+            release_memory();
+        }
+        free(order);
+    }
+}
+
+// ht_find one key at a time against ht_find_batch in chunks of 256 keys on
+// tables much larger than the last level cache, random hit lookups
+static void bench_batch_lookup(void) {
+    HTBackend backends[] = {HT_CHAINED, HT_SWISS, HT_ROBIN_HOOD};
+    const char *names[] = {"chained", "swiss", "robin_hood"};
+    int n = 10000000;
+    int lookups = 5000000;
+    int *keys = malloc(lookups * sizeof(int));
+    void **found = malloc(lookups * sizeof(void *));
+    for (int i = 0; i < lookups; i++) {
+        keys[i] = (int)(((unsigned int)rand() * 2654435761u) % (unsigned int)n);
+    }
+    printf("random hit lookups in %d entries\n", n);
+    printf("%12s %12s %12s %8s\n", "backend", "single_ns", "batch_ns", "speedup");
+    for (int b = 0; b < 3; b++) {
+        HTConfig config = { .backend = backends[b] };
+        Hashtable *ht = ht_create_with(int, int, &config);
+        for (int i = 0; i < n; i++) {
+            ht_put(ht, &i, &i);
+        }
+        long sum = 0;
+        double start = now_ms();
+        for (int i = 0; i < lookups; i++) {
+            sum += *(int *)ht_find(ht, &keys[i]);
+        }
+        double single = (now_ms() - start) * 1e6 / lookups;
+
+        start = now_ms();
+        for (int i = 0; i < lookups; i += 256) {
+            int chunk = lookups - i < 256 ? lookups - i : 256;
+            ht_find_batch(ht, keys + i, chunk, found + i);
+        }
+        double batch = (now_ms() - start) * 1e6 / lookups;
+        for (int i = 0; i < lookups; i++) {
+            sum -= *(int *)found[i];
+        }
+        sink = sum;
+        printf("%12s %12.2f %12.2f %7.2fx\n", names[b], single, batch, single / batch);
+        ht_destroy(ht);
+        release_memory();
+    }
+    free(keys);
+    free(found);
+}
+
+// loading n entries with ht_put one at a time against one ht_put_batch call
+static void bench_bulk_load(void) {
+    HTBackend backends[] = {HT_CHAINED, HT_SWISS, HT_ROBIN_HOOD};
+    const char *names[] = {"chained", "swiss", "robin_hood"};
+    int n = 10000000;
+    int *keys = malloc(n * sizeof(int));
+    for (int i = 0; i < n; i++) {
+        keys[i] = (int)((unsigned int)i * 2654435761u);
+    }
+    printf("loading %d entries\n", n);
+    printf("%12s %12s %12s %8s\n", "backend", "put_ms", "batch_ms", "speedup");
+    for (int b = 0; b < 3; b++) {
+        HTConfig config = { .backend = backends[b] };
+        Hashtable *ht = ht_create_with(int, int, &config);
+        double start = now_ms();
+        for (int i = 0; i < n; i++) {
+            ht_put(ht, &keys[i], &i);
+        }
+        double single = now_ms() - start;
+        ht_destroy(ht);
+        release_memory();
+
+        ht = ht_create_with(int, int, &config);
+        start = now_ms();
+        ht_put_batch(ht, keys, keys, n);
+        double batch = now_ms() - start;
+        sink = ht_count(ht);
+        printf("%12s %12.1f %12.1f %7.2fx\n", names[b], single, batch, single / batch);
+        ht_destroy(ht);
+        release_memory();
+    }
+    free(keys);
+}
+
+// Regression suite, `ht_bench suite [max_entries] [max_mb]` prints one CSV row
+// per workload, key kind, value size, backend and table size. Sizes go from 1K
+// up to max_entries by powers of ten, combinations whose keys and table would
+// need more than max_mb of memory are skipped with a note on stderr.
+
+#define SUITE_MIN_OPS (1 << 20) // lookups and mixed ops cycle through the keys until this many
+#define SUITE_LARGE_VALUE 256
+
+typedef enum KeyKind {
+    KEYS_INT_SEQ,  // 0, 1, 2, ... as int
+    KEYS_INT_RAND, // distinct ints scattered over the whole range
+    KEYS_STR16,    // 16 byte strings, test_cases.h first then random ones of the same alphabet
+} KeyKind;
+
+static const char *key_kind_names[] = {"int_seq", "int_rand", "str16"};
+
+static uint64_t rng_state = 42;
+
+static uint64_t splitmix64(void) {
+    uint64_t z = (rng_state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static size_t key_kind_size(KeyKind kind) {
+    return kind == KEYS_STR16 ? 16 : sizeof(int);
+}
+
+// the i-th key of a kind, misses are drawn so they never equal an inserted key
+static void make_key(KeyKind kind, size_t i, bool miss, unsigned char *out) {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789";
+    int k;
+    switch (kind) {
+    case KEYS_INT_SEQ:
+        k = miss ? -1 - (int)i : (int)i;
+        memcpy(out, &k, sizeof(k));
+        break;
+    case KEYS_INT_RAND:
+        // odd multiplier is a bijection on 32 bits, misses take the other half of the inputs
+        k = (int)((uint32_t)(miss ? i | 0x80000000u : i) * 2654435761u);
+        memcpy(out, &k, sizeof(k));
+        break;
+    case KEYS_STR16:
+        if (!miss && i < 1000) {
+            memcpy(out, test_cases[i], 16);
+            break;
+        }
+        for (int c = 0; c < 16; c++) {
+            out[c] = (unsigned char)alphabet[splitmix64() % 62];
+        }
+        // test_cases.h strings are alphanumeric, a '-' marks misses apart from them
+        if (miss) {
+            out[0] = '-';
+        }
+        break;
+    }
+}
+
+static void shuffle_keys(unsigned char *keys, size_t n, size_t key_size) {
+    unsigned char tmp[16];
+    for (size_t i = n - 1; i > 0; i--) {
+        size_t j = splitmix64() % (i + 1);
+        memcpy(tmp, keys + i * key_size, key_size);
+        memcpy(keys + i * key_size, keys + j * key_size, key_size);
+        memcpy(keys + j * key_size, tmp, key_size);
+    }
+}
+
+static void csv_row(const char *workload, KeyKind kind, size_t value_size, const char *backend,
+                    size_t n, size_t ops, double ms) {
+    printf("%s,%s,%zu,%s,%zu,%zu,%.2f\n", workload, key_kind_names[kind], value_size, backend,
+           n, ops, ms * 1e6 / ops);
+    fflush(stdout);
+}
+
+// insert, resize, hit and miss lookups, mixed, then delete on one table of n entries
+static void suite_run(KeyKind kind, size_t value_size, HTBackend backend, const char *backend_name,
+                      size_t n, const unsigned char *keys, const unsigned char *hits,
+                      const unsigned char *misses) {
+    size_t key_size = key_kind_size(kind);
+    unsigned char *value = calloc(1, value_size);
+    HTConfig config = { .backend = backend };
+    Hashtable *ht = _ht_create_with(key_size, value_size, &config);
+    size_t ops = n > SUITE_MIN_OPS ? n : SUITE_MIN_OPS;
+    long sum = 0;
+
+    double start = now_ms();
+    for (size_t i = 0; i < n; i++) {
+        ht_put(ht, keys + i * key_size, value);
+    }
+    csv_row("insert", kind, value_size, backend_name, n, n, now_ms() - start);
+
+    start = now_ms();
+    ht_resize(ht, 2 * ht->arr_cap);
+    csv_row("resize", kind, value_size, backend_name, n, n, now_ms() - start);
+
+    start = now_ms();
+    for (size_t i = 0; i < ops; i++) {
+        sum += ht_find(ht, hits + (i % n) * key_size) != NULL;
+    }
+    csv_row("hit", kind, value_size, backend_name, n, ops, now_ms() - start);
+
+    start = now_ms();
+    for (size_t i = 0; i < ops; i++) {
+        sum += ht_find(ht, misses + (i % n) * key_size) != NULL;
+    }
+    csv_row("miss", kind, value_size, backend_name, n, ops, now_ms() - start);
+
+    // 80% hits, 10% inserts of new keys and 10% deletes of keys the mix
+    // inserted lag puts earlier, so the table size stays about the same
+    size_t lag = n / 2 < 1024 ? n / 2 : 1024;
+    size_t puts = 0;
+    start = now_ms();
+    for (size_t i = 0; i < ops; i++) {
+        size_t r = i % 10;
+        if (r < 8) {
+            sum += ht_find(ht, hits + (i % n) * key_size) != NULL;
+        } else if (r == 8) {
+            ht_put(ht, misses + (puts++ % n) * key_size, value);
+        } else if (puts > lag) {
+            ht_delete(ht, misses + ((puts - lag) % n) * key_size);
+        }
+    }
+    csv_row("mixed", kind, value_size, backend_name, n, ops, now_ms() - start);
+
+    start = now_ms();
+    for (size_t i = 0; i < n; i++) {
+        ht_delete(ht, hits + i * key_size);
+    }
+    csv_row("delete", kind, value_size, backend_name, n, n, now_ms() - start);
+
+    sink = sum;
+    ht_destroy(ht);
+    free(value);
+    release_memory();
+}
+
+static void bench_suite(size_t max_entries, size_t max_mb) {
+    HTBackend backends[] = {HT_CHAINED, HT_SWISS, HT_ROBIN_HOOD};
+    const char *names[] = {"chained", "swiss", "robin_hood"};
+    size_t value_sizes[] = {sizeof(int), SUITE_LARGE_VALUE};
+    printf("workload,keys,value_bytes,backend,entries,ops,ns_per_op\n");
+    for (size_t n = 1000; n <= max_entries; n *= 10) {
+        for (int kind = KEYS_INT_SEQ; kind <= KEYS_STR16; kind++) {
+            size_t key_size = key_kind_size(kind);
+            for (size_t v = 0; v < sizeof(value_sizes) / sizeof(value_sizes[0]); v++) {
+                // keys, shuffled hits and misses, plus a table at about half load
+                // with a node or slot header per entry
+                size_t per_entry = 3 * key_size + 2 * (key_size + value_sizes[v] + 32);
+                if (n * per_entry / (1024 * 1024) > max_mb) {
+                    fprintf(stderr, "skipping %zu %s keys with %zu byte values, over %zu MB\n",
+                            n, key_kind_names[kind], value_sizes[v], max_mb);
+                    continue;
+                }
+                unsigned char *keys = malloc(n * key_size);
+                unsigned char *hits = malloc(n * key_size);
+                unsigned char *misses = malloc(n * key_size);
+                if (!keys || !hits || !misses) {
+                    fprintf(stderr, "failed to allocate %zu keys\n", n);
+                    exit(1);
+                }
+                rng_state = 42;
+                for (size_t i = 0; i < n; i++) {
+                    make_key(kind, i, false, keys + i * key_size);
+                    make_key(kind, i, true, misses + i * key_size);
+                }
+                memcpy(hits, keys, n * key_size);
+                shuffle_keys(hits, n, key_size);
+                for (int b = 0; b < 3; b++) {
+                    suite_run(kind, value_sizes[v], backends[b], names[b], n, keys, hits, misses);
+                }
+                free(keys);
+                free(hits);
+                free(misses);
+            }
+        }
+    }
+}
+
+// Thread scaling, `ht_bench concurrent [ops_per_thread] [put_percent]`. Every
+// thread runs the same get / put mix over a preloaded key range, against a plain
+// table behind one global mutex, the lock striped table, and the striped table
+// with lock free epoch readers.
+
+#define CONCURRENT_KEYS 1000000
+
+typedef struct ScaleArg {
+    Hashtable *ht; // guarded by mutex when set
+    pthread_mutex_t *mutex;
+    HTConcurrent *ct;
+    long ops;
+    unsigned int put_per_1024;
+    unsigned int seed;
+    long hits;
+} ScaleArg;
+
+static void *scale_worker(void *p) {
+    ScaleArg *arg = p;
+    unsigned int x = arg->seed;
+    long hits = 0;
+    for (long i = 0; i < arg->ops; i++) {
+        x = x * 1664525u + 1013904223u;
+        int key = (int)((x >> 8) % CONCURRENT_KEYS);
+        int value = key;
+        bool put = (x & 0x3FF) < arg->put_per_1024;
+        if (arg->ct) {
+            hits += put ? ht_concurrent_put(arg->ct, &key, &value) : ht_concurrent_get(arg->ct, &key, &value);
+        } else {
+            pthread_mutex_lock(arg->mutex);
+            hits += put ? ht_put(arg->ht, &key, &value) : ht_get(arg->ht, &key, &value);
+            pthread_mutex_unlock(arg->mutex);
+        }
+    }
+    arg->hits = hits;
+    return NULL;
+}
+
+// wall clock of threads workers each running ops operations
+static double scale_run(int threads, long ops, unsigned int put_per_1024, Hashtable *ht, pthread_mutex_t *mutex, HTConcurrent *ct) {
+    pthread_t ids[64];
+    ScaleArg args[64];
+    double start = now_ms();
+    int started = 0;
+    for (int t = 0; t < threads; t++) {
+        args[t] = (ScaleArg){ .ht = ht, .mutex = mutex, .ct = ct, .ops = ops, .put_per_1024 = put_per_1024, .seed = 12345u + t };
+        if (pthread_create(&ids[t], NULL, scale_worker, &args[t]) != 0) {
+            fprintf(stderr, "failed to start thread %d of %d, timing the %d started\n", t + 1, threads, started);
+            break;
+        }
+        started++;
+    }
+    for (int t = 0; t < started; t++) {
+        pthread_join(ids[t], NULL);
+        sink += args[t].hits;
+    }
+    return now_ms() - start;
+}
+
+static void bench_concurrent(long ops, int put_percent) {
+    unsigned int put_per_1024 = (unsigned int)(put_percent * 1024 / 100);
+    Hashtable *ht = ht_create(int, int);
+    pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+    HTConcurrent *ct = ht_concurrent_create(int, int, 0);
+    HTConcurrentConfig epoch_config = { .read_mode = HT_READ_EPOCH };
+    HTConcurrent *epoch = ht_concurrent_create_with(int, int, &epoch_config);
+    for (int i = 0; i < CONCURRENT_KEYS; i++) {
+        ht_put(ht, &i, &i);
+        ht_concurrent_put(ct, &i, &i);
+        ht_concurrent_put(epoch, &i, &i);
+    }
+    printf("%d%% get / %d%% put over %d keys, %ld ops per thread\n", 100 - put_percent, put_percent, CONCURRENT_KEYS, ops);
+    printf("%8s %14s %14s %14s\n", "threads", "mutex_mops", "striped_mops", "epoch_mops");
+    for (int threads = 1; threads <= 64; threads *= 2) {
+        double global = scale_run(threads, ops, put_per_1024, ht, &mutex, NULL);
+        double striped = scale_run(threads, ops, put_per_1024, NULL, NULL, ct);
+        double lock_free = scale_run(threads, ops, put_per_1024, NULL, NULL, epoch);
+        double total = (double)threads * ops;
+        printf("%8d %14.2f %14.2f %14.2f\n", threads, total / global / 1e3, total / striped / 1e3, total / lock_free / 1e3);
+    }
+    ht_destroy(ht);
+    ht_concurrent_destroy(ct);
+    ht_concurrent_destroy(epoch);
+    release_memory();
+}
+
+// Resize pauses, `ht_bench sharded [entries]`. Loads int keys into one table and
+// into a table split in HT_SHARDED_DEFAULT_SHARDS shards, reporting the total
+// time and the slowest single put, which is the put that triggered a resize.
+static void bench_sharded(int n) {
+    HTBackend backends[] = {HT_CHAINED, HT_SWISS, HT_ROBIN_HOOD};
+    const char *names[] = {"chained", "swiss", "robin_hood"};
+    printf("loading %d entries, %d shards\n", n, HT_SHARDED_DEFAULT_SHARDS);
+    printf("%12s %12s %12s %14s %14s\n", "backend", "single_ms", "sharded_ms", "single_max_ms", "sharded_max_ms");
+    for (int b = 0; b < 3; b++) {
+        HTConfig config = { .backend = backends[b] };
+        Hashtable *ht = ht_create_with(int, int, &config);
+        double worst_single = 0;
+        double start = now_ms();
+        for (int i = 0; i < n; i++) {
+            double put_start = now_ms();
+            ht_put(ht, &i, &i);
+            double elapsed = now_ms() - put_start;
+            worst_single = elapsed > worst_single ? elapsed : worst_single;
+        }
+        double single = now_ms() - start;
+        ht_destroy(ht);
+        release_memory();
+
+        HTSharded *sh = ht_sharded_create(int, int, 0, &config);
+        double worst_sharded = 0;
+        start = now_ms();
+        for (int i = 0; i < n; i++) {
+            double put_start = now_ms();
+            ht_sharded_put(sh, &i, &i);
+            double elapsed = now_ms() - put_start;
+            worst_sharded = elapsed > worst_sharded ? elapsed : worst_sharded;
+        }
+        double sharded = now_ms() - start;
+        sink = ht_sharded_count(sh);
+        printf("%12s %12.1f %12.1f %14.2f %14.2f\n", names[b], single, sharded, worst_single, worst_sharded);
+        ht_sharded_destroy(sh);
+        release_memory();
+    }
+}
+
+static void scan_entry(void *key, void *value, void *ctx) {
+    *(long *)ctx += *(int *)value;
+}
+
+static void scan_reduce(void *key, void *value, void *acc, void *ctx) {
+    *(long *)acc += *(int *)value;
+}
+
+static void scan_combine(void *out_acc, const void *worker_acc, void *ctx) {
+    *(long *)out_acc += *(const long *)worker_acc;
+}
+
+// full table scans of n entries, through the iterator, ht_foreach and
+// ht_parallel_reduce with one thread per CPU
+static void bench_scan(void) {
+    HTBackend backends[] = {HT_CHAINED, HT_SWISS, HT_ROBIN_HOOD};
+    const char *names[] = {"chained", "swiss", "robin_hood"};
+    int n = 10000000;
+    printf("full scans of %d entries\n", n);
+    printf("%12s %12s %12s %12s\n", "backend", "iter_ns", "foreach_ns", "parallel_ns");
+    for (int b = 0; b < 3; b++) {
+        HTConfig config = { .backend = backends[b] };
+        Hashtable *ht = ht_create_with(int, int, &config);
+        for (int i = 0; i < n; i++) {
+            int key = (int)((unsigned int)i * 2654435761u);
+            ht_put(ht, &key, &i);
+        }
+        long sum = 0;
+        HTIterator iter;
+        HTEntry entry;
+        ht_iterator_init(&iter, ht);
+        double start = now_ms();
+        while (ht_iterator_next(&iter, &entry)) {
+            sum += *(int *)entry.value;
+        }
+        double iterated = (now_ms() - start) * 1e6 / n;
+
+        start = now_ms();
+        ht_foreach(ht, scan_entry, &sum);
+        double foreach = (now_ms() - start) * 1e6 / n;
+
+        long zero = 0, total;
+        start = now_ms();
+        ht_parallel_reduce(ht, 0, &zero, sizeof(long), scan_reduce, scan_combine, NULL, &total);
+        double parallel = (now_ms() - start) * 1e6 / n;
+        sink = sum + total;
+        printf("%12s %12.2f %12.2f %12.2f\n", names[b], iterated, foreach, parallel);
+        ht_destroy(ht);
+        release_memory();
+    }
+}
+
+// Warm restarts, `ht_bench snapshot [entries] [path]`. Rebuilds a table of int
+// keys by putting every entry again, then saves it and loads the snapshot back.
+static void bench_snapshot(int n, const char *path) {
+    HTBackend backends[] = {HT_CHAINED, HT_SWISS, HT_ROBIN_HOOD};
+    const char *names[] = {"chained", "swiss", "robin_hood"};
+    printf("rebuilding %d entries, snapshot at %s\n", n, path);
+    printf("%12s %12s %12s %12s %12s\n", "backend", "put_ms", "save_ms", "load_ms", "file_mb");
+    for (int b = 0; b < 3; b++) {
+        HTConfig config = { .backend = backends[b] };
+        Hashtable *ht = ht_create_with(int, long, &config);
+        double start = now_ms();
+        for (int i = 0; i < n; i++) {
+            int key = (int)((unsigned int)i * 2654435761u);
+            long value = i;
+            ht_put(ht, &key, &value);
+        }
+        double put = now_ms() - start;
+
+        start = now_ms();
+        if (!ht_save(ht, path)) {
+            ht_destroy(ht);
+            return;
+        }
+        double save = now_ms() - start;
+        ht_destroy(ht);
+        release_memory();
+
+        start = now_ms();
+        Hashtable *loaded = ht_load(path);
+        double load = now_ms() - start;
+        FILE *file = loaded ? fopen(path, "rb") : NULL;
+        if (!file) {
+            fprintf(stderr, "failed to load %s back\n", path);
+            if (loaded) {
+                ht_destroy(loaded);
+            }
+            remove(path);
+            return;
+        }
+        fseek(file, 0, SEEK_END);
+        double file_mb = ftell(file) / 1048576.0;
+        fclose(file);
+        sink = ht_count(loaded);
+        printf("%12s %12.1f %12.1f %12.1f %12.1f\n", names[b], put, save, load, file_mb);
+        ht_destroy(loaded);
+        remove(path);
+        release_memory();
+    }
+}
+
+// Frozen tables, `ht_bench frozen [entries] [path]`. Freezes a chained table of
+// int keys and compares opening the image and looking keys up in it with
+// lookups in the live table.
+static void bench_frozen(int n, const char *path) {
+    Hashtable *ht = ht_create(int, long);
+    for (int i = 0; i < n; i++) {
+        int key = (int)((unsigned int)i * 2654435761u);
+        long value = i;
+        ht_put(ht, &key, &value);
+    }
+    double start = now_ms();
+    if (!ht_freeze(ht, path)) {
+        ht_destroy(ht);
+        return;
+    }
+    double freeze = now_ms() - start;
+
+    HTFrozen fz;
+    start = now_ms();
+    if (!ht_frozen_open(&fz, path, NULL)) {
+        ht_destroy(ht);
+        return;
+    }
+    double open = now_ms() - start;
+
+    long sum = 0;
+    start = now_ms();
+    for (int i = 0; i < n; i++) {
+        int key = (int)((unsigned int)((long)i * 7919 % n) * 2654435761u);
+        sum += ht_frozen_find(&fz, &key) != NULL;
+    }
+    double frozen_ns = (now_ms() - start) * 1e6 / n;
+    start = now_ms();
+    for (int i = 0; i < n; i++) {
+        int key = (int)((unsigned int)((long)i * 7919 % n) * 2654435761u);
+        sum += ht_find(ht, &key) != NULL;
+    }
+    double live_ns = (now_ms() - start) * 1e6 / n;
+    sink = sum;
+    printf("%d entries, %.1f MB image\n", n, fz.map_size / 1048576.0);
+    printf("%12s %12s %16s %14s\n", "freeze_ms", "open_ms", "frozen_find_ns", "live_find_ns");
+    printf("%12.1f %12.3f %16.1f %14.1f\n", freeze, open, frozen_ns, live_ns);
+    ht_frozen_close(&fz);
+    ht_destroy(ht);
+    remove(path);
+}
+
+// Perfect hashing, `ht_bench perfect [entries]`. Builds the minimal perfect hash
+// table of a chained table of int keys and compares its lookups with the source's.
+static void bench_perfect(int n) {
+    Hashtable *ht = ht_create(int, long);
+    for (int i = 0; i < n; i++) {
+        int key = (int)((unsigned int)i * 2654435761u);
+        long value = i;
+        ht_put(ht, &key, &value);
+    }
+    double start = now_ms();
+    HTPerfect *ph = ht_perfect_create(ht);
+    double build = now_ms() - start;
+    if (!ph) {
+        ht_destroy(ht);
+        return;
+    }
+
+    long found = 0;
+    start = now_ms();
+    for (int i = 0; i < n; i++) {
+        int key = (int)((unsigned int)((long)i * 7919 % n) * 2654435761u);
+        found += ht_perfect_find(ph, &key) != NULL;
+    }
+    double perfect_ns = (now_ms() - start) * 1e6 / n;
+    start = now_ms();
+    for (int i = 0; i < n; i++) {
+        int key = (int)((unsigned int)((long)i * 7919 % n) * 2654435761u);
+        found += ht_find(ht, &key) != NULL;
+    }
+    double live_ns = (now_ms() - start) * 1e6 / n;
+    sink = found;
+    printf("%d entries, %u bit pilots\n", n, ph->pilot_bits);
+    printf("%12s %14s %17s %14s\n", "build_ms", "bits_per_key", "perfect_find_ns", "live_find_ns");
+    printf("%12.1f %14.2f %17.1f %14.1f\n", build, ht_perfect_bits_per_key(ph), perfect_ns, live_ns);
+    ht_perfect_destroy(ph);
+    ht_destroy(ht);
+}
+
+// String keys, `ht_bench strkeys [entries]`. Loads keys of 16 and of 48
+// characters into an HT_VARLEN_KEY table and times puts, hits and misses.
+static void bench_strkeys(int n) {
+    size_t lens[] = {16, 48};
+    printf("%d keys per length\n", n);
+    printf("%8s %10s %10s %10s %14s\n", "key_len", "put_ns", "hit_ns", "miss_ns", "bytes_per_key");
+    for (int l = 0; l < 2; l++) {
+        size_t len = lens[l];
+        char *keys = (char *)malloc((size_t)n * (len + 1));
+        for (int i = 0; i < n; i++) {
+            char *key = keys + (size_t)i * (len + 1);
+            for (size_t c = 0; c < len; c++) {
+                key[c] = 'a' + (char)(splitmix64() % 26);
+            }
+            key[len] = '\0';
+        }
+        Hashtable *ht = ht_create_str(int);
+        double start = now_ms();
+        for (int i = 0; i < n; i++) {
+            ht_put_str(ht, keys + (size_t)i * (len + 1), &i);
+        }
+        double put = (now_ms() - start) * 1e6 / n;
+
+        long found = 0;
+        start = now_ms();
+        for (int i = 0; i < n; i++) {
+            found += ht_find_bytes(ht, keys + (size_t)((long)i * 7919 % n) * (len + 1), len) != NULL;
+        }
+        double hit = (now_ms() - start) * 1e6 / n;
+        // same length and first characters, last character differs
+        for (int i = 0; i < n; i++) {
+            keys[(size_t)i * (len + 1) + len - 1] = '#';
+        }
+        start = now_ms();
+        for (int i = 0; i < n; i++) {
+            found += ht_find_bytes(ht, keys + (size_t)((long)i * 7919 % n) * (len + 1), len) != NULL;
+        }
+        double miss = (now_ms() - start) * 1e6 / n;
+        sink = found;
+
+        HTStats stats;
+        ht_stats(ht, &stats);
+        printf("%8zu %10.1f %10.1f %10.1f %14.1f\n", len, put, hit, miss,
+               (double)(stats.node_bytes + stats.bucket_bytes) / n);
+        ht_destroy(ht);
+        free(keys);
+        release_memory();
+    }
+}
+
+// Counting, `ht_bench counting [ops] [keys]`. Bumps a counter per key over ops
+// keys drawn from keys distinct ones, ops / 4 by default, with ht_find and
+// ht_put on a miss against one ht_get_or_insert.
+static void bench_counting(int n, int distinct) {
+    const char *names[] = {"chained", "swiss", "robin_hood"};
+    HTBackend backends[] = {HT_CHAINED, HT_SWISS, HT_ROBIN_HOOD};
+    distinct = distinct > 0 ? distinct : 1;
+    printf("%d ops over %d keys\n", n, distinct);
+    printf("%12s %16s %18s\n", "backend", "find_put_ns", "get_or_insert_ns");
+    for (int b = 0; b < 3; b++) {
+        HTConfig config = { .backend = backends[b] };
+        Hashtable *ht = ht_create_with(int, long, &config);
+        double start = now_ms();
+        for (int i = 0; i < n; i++) {
+            int key = (int)((unsigned int)((long)i * 7919 % distinct) * 2654435761u);
+            long *count = ht_find(ht, &key);
+            if (count) {
+                (*count)++;
+            } else {
+                long one = 1;
+                ht_put(ht, &key, &one);
+            }
+        }
+        double find_put = (now_ms() - start) * 1e6 / n;
+        ht_destroy(ht);
+        release_memory();
+
+        ht = ht_create_with(int, long, &config);
+        start = now_ms();
+        for (int i = 0; i < n; i++) {
+            int key = (int)((unsigned int)((long)i * 7919 % distinct) * 2654435761u);
+            long *count = ht_get_or_insert(ht, &key, NULL);
+            (*count)++;
+        }
+        double get_or_insert = (now_ms() - start) * 1e6 / n;
+        sink = (long)ht_count(ht);
+        ht_destroy(ht);
+        release_memory();
+        printf("%12s %16.1f %18.1f\n", names[b], find_put, get_or_insert);
+    }
+}
+
+HT_DEFINE(BenchIntMap, int, long, HT_HASH_INTEGER, HT_EQ_SCALAR)
+
+// Specialized tables, `ht_bench specialized [entries]`. The same int to long
+// puts and lookups through the generic API and through an HT_DEFINE table.
+static void bench_specialized(int n) {
+    Hashtable *ht = ht_create(int, long);
+    double start = now_ms();
+    for (int i = 0; i < n; i++) {
+        int key = (int)((unsigned int)i * 2654435761u);
+        long value = i;
+        ht_put(ht, &key, &value);
+    }
+    double generic_put = (now_ms() - start) * 1e6 / n;
+    long found = 0;
+    start = now_ms();
+    for (int i = 0; i < n; i++) {
+        int key = (int)((unsigned int)((long)i * 7919 % n) * 2654435761u);
+        found += ht_find(ht, &key) != NULL;
+    }
+    double generic_find = (now_ms() - start) * 1e6 / n;
+    ht_destroy(ht);
+    release_memory();
+
+    BenchIntMap map;
+    BenchIntMap_init(&map);
+    start = now_ms();
+    for (int i = 0; i < n; i++) {
+        BenchIntMap_put(&map, (int)((unsigned int)i * 2654435761u), i);
+    }
+    double specialized_put = (now_ms() - start) * 1e6 / n;
+    start = now_ms();
+    for (int i = 0; i < n; i++) {
+        found += BenchIntMap_find(&map, (int)((unsigned int)((long)i * 7919 % n) * 2654435761u)) != NULL;
+    }
+    double specialized_find = (now_ms() - start) * 1e6 / n;
+    sink = found;
+    BenchIntMap_deinit(&map);
+    release_memory();
+
+    printf("%d entries\n", n);
+    printf("%12s %10s %10s\n", "table", "put_ns", "find_ns");
+    printf("%12s %10.1f %10.1f\n", "generic", generic_put, generic_find);
+    printf("%12s %10.1f %10.1f\n", "specialized", specialized_put, specialized_find);
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1 && strcmp(argv[1], "suite") == 0) {
+        size_t max_entries = argc > 2 ? strtoull(argv[2], NULL, 10) : 100000000;
+        size_t max_mb = argc > 3 ? strtoull(argv[3], NULL, 10) : 8192;
+        bench_suite(max_entries, max_mb);
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "sharded") == 0) {
+        bench_sharded(argc > 2 ? atoi(argv[2]) : 10000000);
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "snapshot") == 0) {
+        bench_snapshot(argc > 2 ? atoi(argv[2]) : 10000000, argc > 3 ? argv[3] : "ht_bench_snapshot.bin");
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "frozen") == 0) {
+        bench_frozen(argc > 2 ? atoi(argv[2]) : 10000000, argc > 3 ? argv[3] : "ht_bench_frozen.bin");
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "perfect") == 0) {
+        bench_perfect(argc > 2 ? atoi(argv[2]) : 10000000);
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "strkeys") == 0) {
+        bench_strkeys(argc > 2 ? atoi(argv[2]) : 1000000);
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "specialized") == 0) {
+        bench_specialized(argc > 2 ? atoi(argv[2]) : 10000000);
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "counting") == 0) {
+        int ops = argc > 2 ? atoi(argv[2]) : 10000000;
+        bench_counting(ops, argc > 3 ? atoi(argv[3]) : ops / 4);
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "concurrent") == 0) {
+        bench_concurrent(argc > 2 ? strtol(argv[2], NULL, 10) : 1000000, argc > 3 ? atoi(argv[3]) : 10);
+        return 0;
+    }
+    srand(42);
+    bench_resize();
+    bench_cap_policy();
+    bench_batch_lookup();
+    bench_bulk_load();
+    bench_scan();
+    return 0;
+}
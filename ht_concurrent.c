@@ -0,0 +1,459 @@
+#include "ht_concurrent.h"
+#include "ht_internal.h"
+#include <assert.h>
+
+// Lock striping over a chained table. The bucket index of a hash is the top
+// log2(arr_cap) bits of its Fibonacci product and the stripe is the top
+// log2(stripe_count) bits, so while arr_cap >= stripe_count every bucket belongs
+// to exactly one stripe and holding that stripe is enough to walk or relink it.
+// arr_cap and arr only change with every stripe held, so they can be read once
+// any single stripe is.
+//
+// In HT_READ_EPOCH mode readers hold nothing. Bucket heads and HTNode.next are
+// then written with release stores and read with acquire loads, through the
+// __atomic builtins since HTNode is shared with the plain tables. A node is
+// never written once published: an update links in a copy, and unlinked nodes
+// wait on their stripe's retired list until the epoch shows no reader is left.
+
+#define RETIRE_BATCH 64 // retired nodes a stripe collects before it tries to reclaim
+
+static size_t round_pow2(size_t x) {
+    size_t p = 1;
+    while (p < x) {
+        p <<= 1;
+    }
+    return p;
+}
+
+static HTStripe *stripe_of(HTConcurrent *ct, uint64_t key_hash) {
+    if (ct->stripe_count == 1) {
+        return ct->stripes;
+    }
+    return &ct->stripes[bucket_index(&ct->table, key_hash, ct->stripe_count)];
+}
+
+static void lock_all(HTConcurrent *ct) {
+    for (size_t i = 0; i < ct->stripe_count; i++) {
+        pthread_rwlock_wrlock(&ct->stripes[i].lock);
+    }
+}
+
+static void unlock_all(HTConcurrent *ct) {
+    for (size_t i = ct->stripe_count; i-- > 0;) {
+        pthread_rwlock_unlock(&ct->stripes[i].lock);
+    }
+}
+
+// link pointing at the node holding key in its bucket, or NULL, the stripe of
+// key_hash has to be held
+static HTNode **find_link(HTConcurrent *ct, const void *key, uint64_t key_hash) {
+    Hashtable *ht = &ct->table;
+    for (HTNode **link = &ht->arr[bucket_index(ht, key_hash, ht->arr_cap)]; *link != NULL; link = &(*link)->next) {
+        if (key_hash == (*link)->stored_hash && memcmp(key, ht_node_key(*link), ht->key_size) == 0) {
+            return link;
+        }
+    }
+    return NULL;
+}
+
+// lock free lookup, the caller is inside an epoch read section
+static HTNode *epoch_find(HTConcurrent *ct, const void *key, uint64_t key_hash) {
+    while (true) {
+        unsigned seq = atomic_load_explicit(&ct->resize_seq, memory_order_acquire);
+        HTBucketArray *buckets = atomic_load_explicit(&ct->buckets, memory_order_acquire);
+        HTNode **head = &buckets->heads[bucket_index(&ct->table, key_hash, buckets->cap)];
+        for (HTNode *node = __atomic_load_n(head, __ATOMIC_ACQUIRE); node != NULL;
+             node = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE)) {
+            if (key_hash == node->stored_hash && memcmp(key, ht_node_key(node), ct->table.key_size) == 0) {
+                return node;
+            }
+        }
+        // a resize relinking nodes into new chains can carry the walk past the
+        // key, so a miss only counts if no resize ran meanwhile
+        atomic_thread_fence(memory_order_acquire);
+        if (!(seq & 1) && atomic_load_explicit(&ct->resize_seq, memory_order_relaxed) == seq) {
+            return NULL;
+        }
+    }
+}
+
+static HTBucketArray *alloc_buckets(size_t cap) {
+    HTBucketArray *buckets = (HTBucketArray *)calloc(1, sizeof(HTBucketArray) + cap * sizeof(HTNode *));
+    if (buckets) {
+        buckets->cap = cap;
+    }
+    return buckets;
+}
+
+// makes buckets the array readers see and writers use, with every stripe held
+static void publish_buckets(HTConcurrent *ct, HTBucketArray *buckets) {
+    ct->table.arr = buckets->heads;
+    ct->table.arr_cap = buckets->cap;
+    atomic_store_explicit(&ct->buckets, buckets, memory_order_release);
+}
+
+// hands the stripe's retired nodes back to its slab once no reader can hold
+// them, the stripe is held
+static void reclaim(HTStripe *stripe) {
+    if (stripe->retired_count < RETIRE_BATCH) {
+        return;
+    }
+    uint64_t epoch = ht_epoch_advance();
+    size_t kept = 0;
+    for (size_t i = 0; i < stripe->retired_count; i++) {
+        if (stripe->retired[i].epoch + 2 <= epoch) {
+            ht_slab_free(&stripe->slab, stripe->retired[i].node);
+        } else {
+            stripe->retired[kept++] = stripe->retired[i];
+        }
+    }
+    stripe->retired_count = kept;
+}
+
+// node has just been unlinked, the stripe is held
+static void retire(HTStripe *stripe, HTNode *node) {
+    uint64_t epoch = ht_epoch_now();
+    if (stripe->retired_count == stripe->retired_cap) {
+        size_t cap = stripe->retired_cap ? 2 * stripe->retired_cap : RETIRE_BATCH;
+        HTRetired *retired = realloc(stripe->retired, cap * sizeof(HTRetired));
+        if (!retired) {
+            // readers take no locks, so waiting them out here can't deadlock
+            ht_epoch_synchronize();
+            ht_slab_free(&stripe->slab, node);
+            return;
+        }
+        stripe->retired = retired;
+        stripe->retired_cap = cap;
+    }
+    stripe->retired[stripe->retired_count++] = (HTRetired){ .node = node, .epoch = epoch };
+    reclaim(stripe);
+}
+
+bool ht_concurrent_init(HTConcurrent *ct, size_t key_size, size_t value_size, size_t stripes, const HTConfig *config) {
+    HTConcurrentConfig concurrent_config = { .stripes = stripes, .read_mode = HT_READ_LOCKED };
+    if (config) {
+        concurrent_config.table = *config;
+    }
+    return ht_concurrent_init_with(ct, key_size, value_size, &concurrent_config);
+}
+
+bool ht_concurrent_init_with(HTConcurrent *ct, size_t key_size, size_t value_size, const HTConcurrentConfig *config) {
+    if (!ct) {
+        fprintf(stderr, "A valid hashtable pointer is required for init\n");
+        return false;
+    }
+    if (key_size == HT_VARLEN_KEY) {
+        fprintf(stderr, "Concurrent tables need a fixed key_size\n");
+        return false;
+    }
+    HTConfig table_config = config ? config->table : (HTConfig){0};
+    table_config.backend = HT_CHAINED;
+    table_config.cap_policy = HT_CAP_POW2;
+    table_config.incremental_rehash = false;
+    if (!ht_init_with(&ct->table, key_size, value_size, &table_config)) {
+        return false;
+    }
+
+    size_t stripes = config && config->stripes ? config->stripes : HT_CONCURRENT_DEFAULT_STRIPES;
+    ct->stripe_count = round_pow2(stripes);
+    ct->read_mode = config ? config->read_mode : HT_READ_LOCKED;
+    if (ct->table.arr_cap < ct->stripe_count && !ht_resize(&ct->table, ct->stripe_count)) {
+        ht_deinit(&ct->table);
+        return false;
+    }
+    atomic_init(&ct->buckets, NULL);
+    atomic_init(&ct->resize_seq, 0);
+    if (ct->read_mode == HT_READ_EPOCH) {
+        HTBucketArray *buckets = alloc_buckets(ct->table.arr_cap);
+        if (!buckets) {
+            fprintf(stderr, "Failed to allocate bucket array during ht_concurrent_init\n");
+            ht_deinit(&ct->table);
+            return false;
+        }
+        free(ct->table.arr);
+        publish_buckets(ct, buckets);
+    }
+    ct->stripes = (HTStripe *)aligned_alloc(_Alignof(HTStripe), ct->stripe_count * sizeof(HTStripe));
+    if (!ct->stripes) {
+        fprintf(stderr, "Failed to allocate lock stripes during ht_concurrent_init\n");
+        ct->stripe_count = 0;
+        ht_concurrent_deinit(ct);
+        return false;
+    }
+    for (size_t i = 0; i < ct->stripe_count; i++) {
+        memset(&ct->stripes[i], 0, sizeof(HTStripe));
+        pthread_rwlock_init(&ct->stripes[i].lock, NULL);
+        ht_slab_init(&ct->stripes[i].slab, ct->table.slab.node_size);
+    }
+    atomic_init(&ct->count, 0);
+    return true;
+}
+
+HTConcurrent *_ht_concurrent_create(size_t key_size, size_t value_size, size_t stripes, const HTConfig *config) {
+    HTConcurrentConfig concurrent_config = { .stripes = stripes, .read_mode = HT_READ_LOCKED };
+    if (config) {
+        concurrent_config.table = *config;
+    }
+    return _ht_concurrent_create_with(key_size, value_size, &concurrent_config);
+}
+
+HTConcurrent *_ht_concurrent_create_with(size_t key_size, size_t value_size, const HTConcurrentConfig *config) {
+    HTConcurrent *ct = (HTConcurrent *)malloc(sizeof(HTConcurrent));
+    if (!ct) {
+        fprintf(stderr, "Failed to allocate hashtable during ht_concurrent_create\n");
+        return NULL;
+    }
+    if (!ht_concurrent_init_with(ct, key_size, value_size, config)) {
+        fprintf(stderr, "Failed to call ht_concurrent_init during ht_concurrent_create\n");
+        free(ct);
+        return NULL;
+    }
+    return ct;
+}
+
+// HT_READ_EPOCH resize with every stripe held. Nodes are relinked in place, so
+// resize_seq is odd meanwhile and readers that miss look again. The old array
+// is freed once every reader that could have loaded it is gone.
+static bool epoch_resize(HTConcurrent *ct, size_t new_cap) {
+    Hashtable *ht = &ct->table;
+    HTBucketArray *old = atomic_load_explicit(&ct->buckets, memory_order_relaxed);
+    HTBucketArray *buckets = alloc_buckets(round_pow2(new_cap));
+    if (!buckets) {
+        fprintf(stderr, "ht_resize, failed to allocate new bucket array, old ht preserved\n");
+        return false;
+    }
+    unsigned seq = atomic_load_explicit(&ct->resize_seq, memory_order_relaxed);
+    atomic_store_explicit(&ct->resize_seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    for (size_t i = 0; i < old->cap; i++) {
+        for (HTNode *node = old->heads[i], *next; node != NULL; node = next) {
+            next = node->next;
+            size_t bucket_idx = bucket_index(ht, node->stored_hash, buckets->cap);
+            __atomic_store_n(&node->next, buckets->heads[bucket_idx], __ATOMIC_RELEASE);
+            buckets->heads[bucket_idx] = node;
+        }
+    }
+    publish_buckets(ct, buckets);
+    atomic_store_explicit(&ct->resize_seq, seq + 2, memory_order_release);
+
+    ht_epoch_synchronize();
+    free(old);
+    return true;
+}
+
+// every stripe is held
+static bool resize_locked(HTConcurrent *ct, size_t new_cap) {
+    if (ct->read_mode == HT_READ_EPOCH) {
+        return epoch_resize(ct, new_cap);
+    }
+    ct->table.count = atomic_load(&ct->count);
+    return ht_resize(&ct->table, new_cap);
+}
+
+// called with no stripe held, another thread may have grown the table already
+static bool grow(HTConcurrent *ct) {
+    bool ok = true;
+    lock_all(ct);
+    Hashtable *ht = &ct->table;
+    if ((float)atomic_load(&ct->count) / ht->arr_cap >= 0.75) {
+        ok = resize_locked(ct, 2 * ht->arr_cap);
+    }
+    unlock_all(ct);
+    return ok;
+}
+
+static HTNode *new_node(HTConcurrent *ct, HTStripe *stripe, const void *key, const void *value, uint64_t key_hash) {
+    HTNode *node = ht_slab_alloc(&stripe->slab);
+    if (!node) {
+        fprintf(stderr, "Failed to allocate new HTNode in ht_concurrent_put\n");
+        return NULL;
+    }
+    memcpy(ht_node_key(node), key, ct->table.key_size);
+    memcpy(ht_node_value(&ct->table, node), value, ct->table.value_size);
+    node->stored_hash = key_hash;
+    return node;
+}
+
+bool ht_concurrent_put(HTConcurrent *ct, const void *key, const void *value) {
+    assert(ct); assert(key); assert(value);
+    Hashtable *ht = &ct->table;
+    uint64_t key_hash = ht->hash_fn(key, ht->key_size);
+    HTStripe *stripe = stripe_of(ct, key_hash);
+    pthread_rwlock_wrlock(&stripe->lock);
+    HTNode **link = find_link(ct, key, key_hash);
+    if (link && ct->read_mode == HT_READ_LOCKED) {
+        memcpy(ht_node_value(ht, *link), value, ht->value_size);
+        pthread_rwlock_unlock(&stripe->lock);
+        return true;
+    }
+
+    HTNode *node = new_node(ct, stripe, key, value, key_hash);
+    if (!node) {
+        pthread_rwlock_unlock(&stripe->lock);
+        return false;
+    }
+    if (link) {
+        // a reader may be copying the old value, so the update takes its place
+        HTNode *old = *link;
+        node->next = old->next;
+        __atomic_store_n(link, node, __ATOMIC_RELEASE);
+        retire(stripe, old);
+        pthread_rwlock_unlock(&stripe->lock);
+        return true;
+    }
+    HTNode **head = &ht->arr[bucket_index(ht, key_hash, ht->arr_cap)];
+    node->next = *head;
+    __atomic_store_n(head, node, __ATOMIC_RELEASE);
+    size_t count = atomic_fetch_add(&ct->count, 1) + 1;
+    bool full = (float)count / ht->arr_cap >= 0.75;
+    pthread_rwlock_unlock(&stripe->lock);
+
+    if (full && !grow(ct)) {
+        // the entry is in, the table just stays more loaded than it should
+        fprintf(stderr, "Failed call to ht_resize in ht_concurrent_put\n");
+    }
+    return true;
+}
+
+bool ht_concurrent_get(HTConcurrent *ct, const void *key, void *out_value) {
+    assert(ct); assert(key); assert(out_value);
+    uint64_t key_hash = ct->table.hash_fn(key, ct->table.key_size);
+    if (ct->read_mode == HT_READ_EPOCH) {
+        ht_epoch_enter();
+        HTNode *node = epoch_find(ct, key, key_hash);
+        if (node) {
+            memcpy(out_value, ht_node_value(&ct->table, node), ct->table.value_size);
+        }
+        ht_epoch_exit();
+        return node != NULL;
+    }
+    HTStripe *stripe = stripe_of(ct, key_hash);
+    pthread_rwlock_rdlock(&stripe->lock);
+    HTNode **link = find_link(ct, key, key_hash);
+    if (link) {
+        memcpy(out_value, ht_node_value(&ct->table, *link), ct->table.value_size);
+    }
+    pthread_rwlock_unlock(&stripe->lock);
+    return link != NULL;
+}
+
+bool ht_concurrent_contains(HTConcurrent *ct, const void *key) {
+    assert(ct); assert(key);
+    uint64_t key_hash = ct->table.hash_fn(key, ct->table.key_size);
+    if (ct->read_mode == HT_READ_EPOCH) {
+        ht_epoch_enter();
+        bool found = epoch_find(ct, key, key_hash) != NULL;
+        ht_epoch_exit();
+        return found;
+    }
+    HTStripe *stripe = stripe_of(ct, key_hash);
+    pthread_rwlock_rdlock(&stripe->lock);
+    bool found = find_link(ct, key, key_hash) != NULL;
+    pthread_rwlock_unlock(&stripe->lock);
+    return found;
+}
+
+// a node may sit in a different stripe's bucket than the one it was allocated
+// under after a resize, it still goes back to the slab of the stripe held now
+bool ht_concurrent_delete(HTConcurrent *ct, const void *key) {
+    assert(ct); assert(key);
+    uint64_t key_hash = ct->table.hash_fn(key, ct->table.key_size);
+    HTStripe *stripe = stripe_of(ct, key_hash);
+    pthread_rwlock_wrlock(&stripe->lock);
+    HTNode **link = find_link(ct, key, key_hash);
+    if (link) {
+        HTNode *node = *link;
+        if (ct->read_mode == HT_READ_EPOCH) {
+            // node->next is left alone so readers standing on node carry on
+            __atomic_store_n(link, node->next, __ATOMIC_RELEASE);
+            retire(stripe, node);
+        } else {
+            *link = node->next;
+            ht_slab_free(&stripe->slab, node);
+        }
+        atomic_fetch_sub(&ct->count, 1);
+    }
+    pthread_rwlock_unlock(&stripe->lock);
+    return link != NULL;
+}
+
+bool ht_concurrent_resize(HTConcurrent *ct, size_t new_cap) {
+    assert(ct);
+    if (new_cap < ct->stripe_count) {
+        new_cap = ct->stripe_count;
+    }
+    lock_all(ct);
+    bool ok = resize_locked(ct, new_cap);
+    unlock_all(ct);
+    return ok;
+}
+
+// nodes freed under one stripe can sit on another stripe's free list, so every
+// slab is rewound at once with all stripes held. With lock free readers an empty
+// array is published first and the slabs wait until no reader is left.
+void ht_concurrent_clear(HTConcurrent *ct) {
+    assert(ct);
+    lock_all(ct);
+    if (ct->read_mode == HT_READ_EPOCH) {
+        HTBucketArray *old = atomic_load_explicit(&ct->buckets, memory_order_relaxed);
+        HTBucketArray *buckets = alloc_buckets(old->cap);
+        if (buckets) {
+            publish_buckets(ct, buckets);
+            ht_epoch_synchronize();
+            free(old);
+        } else {
+            // no memory for a fresh array, empty the chains one head at a time
+            for (size_t i = 0; i < old->cap; i++) {
+                __atomic_store_n(&old->heads[i], NULL, __ATOMIC_RELEASE);
+            }
+            ht_epoch_synchronize();
+        }
+    } else {
+        memset(ct->table.arr, 0, ct->table.arr_cap * sizeof(HTNode *));
+    }
+    for (size_t i = 0; i < ct->stripe_count; i++) {
+        ht_slab_reset(&ct->stripes[i].slab);
+        ct->stripes[i].retired_count = 0;
+    }
+    atomic_store(&ct->count, 0);
+    unlock_all(ct);
+}
+
+size_t ht_concurrent_count(HTConcurrent *ct) {
+    return atomic_load(&ct->count);
+}
+
+// no other thread may use the table any more
+void ht_concurrent_deinit(HTConcurrent *ct) {
+    for (size_t i = 0; i < ct->stripe_count; i++) {
+        ht_slab_deinit(&ct->stripes[i].slab);
+        free(ct->stripes[i].retired);
+        pthread_rwlock_destroy(&ct->stripes[i].lock);
+    }
+    free(ct->stripes);
+    ct->stripes = NULL;
+    ct->stripe_count = 0;
+    atomic_store(&ct->count, 0);
+    if (ct->read_mode == HT_READ_EPOCH) {
+        // table.arr lives inside the bucket array, the rest of the table only
+        // owns its unused slab
+        free(atomic_load(&ct->buckets));
+        atomic_store(&ct->buckets, NULL);
+        ct->table.arr = NULL;
+        ct->table.arr_cap = 0;
+        ht_slab_deinit(&ct->table.slab);
+        return;
+    }
+    // the buckets only point into the stripe slabs, which are already gone
+    memset(ct->table.arr, 0, ct->table.arr_cap * sizeof(HTNode *));
+    ct->table.count = 0;
+    ht_deinit(&ct->table);
+}
+
+void _ht_concurrent_destroy(HTConcurrent **ct_ptr) {
+    if (ct_ptr && *(ct_ptr)) {
+        ht_concurrent_deinit(*ct_ptr);
+        free(*ct_ptr);
+        *ct_ptr = NULL;
+    }
+}
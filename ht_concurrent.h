@@ -0,0 +1,91 @@
+#ifndef HT_CONCURRENT_H
+#define HT_CONCURRENT_H
+
+#include "hashtable.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+// Thread safe chained table. Buckets are guarded by a fixed array of striped
+// reader-writer locks, an operation only takes the stripe of its key's hash, and
+// a resize takes every stripe in order. Each stripe carves the nodes inserted
+// under it from its own slab, so puts on different stripes never share an
+// allocator. The HT_STATS counters are not fed by this variant.
+
+typedef enum HTReadMode {
+    HT_READ_LOCKED = 0, // readers take the read side of their stripe's lock
+    // readers take no lock at all, writers still serialize on the stripes but
+    // replace nodes instead of writing into them, and unlinked nodes and bucket
+    // arrays are only reused once no reader can still see them, see ht_epoch.c.
+    // For read mostly workloads, a get only writes to its own thread's epoch slot.
+    HT_READ_EPOCH,
+} HTReadMode;
+
+typedef struct HTConcurrentConfig {
+    size_t stripes; // rounded up to a power of two, 0 picks HT_CONCURRENT_DEFAULT_STRIPES
+    HTReadMode read_mode;
+    HTConfig table; // may choose the hash function, backend and capacity policy are fixed
+} HTConcurrentConfig;
+
+// node unlinked by a writer, waiting until no reader can still hold it
+typedef struct HTRetired {
+    HTNode *node;
+    uint64_t epoch;
+} HTRetired;
+
+typedef struct HTStripe {
+    pthread_rwlock_t lock;
+    HTSlab slab;
+    HTRetired *retired; // HT_READ_EPOCH only, oldest first
+    size_t retired_count;
+    size_t retired_cap;
+} __attribute__((aligned(64))) HTStripe; // one cache line or more per stripe, no false sharing
+
+// HT_READ_EPOCH bucket array, published through a single pointer so a reader
+// always sees a capacity together with the heads it belongs to
+typedef struct HTBucketArray {
+    size_t cap;
+    HTNode *heads[];
+} HTBucketArray;
+
+typedef struct HTConcurrent {
+    // HT_CHAINED with power of two buckets, never fewer buckets than stripes, so
+    // the stripe of a hash is a prefix of its bucket index at every capacity
+    Hashtable table;
+    HTStripe *stripes;
+    size_t stripe_count;
+    _Atomic size_t count;
+    HTReadMode read_mode;
+    // HT_READ_EPOCH, table.arr is buckets->heads. resize_seq is odd while a resize
+    // relinks nodes, a reader that misses during one looks again
+    _Atomic(HTBucketArray *) buckets;
+    _Atomic unsigned resize_seq;
+} HTConcurrent;
+
+#define HT_CONCURRENT_DEFAULT_STRIPES 64
+
+// stripes is rounded up to a power of two, 0 picks HT_CONCURRENT_DEFAULT_STRIPES.
+// config may choose the hash function, backend and capacity policy are fixed.
+bool ht_concurrent_init(HTConcurrent *ct, size_t key_size, size_t value_size, size_t stripes, const HTConfig *config);
+// a NULL config gives the defaults, HT_CONCURRENT_DEFAULT_STRIPES locked stripes
+bool ht_concurrent_init_with(HTConcurrent *ct, size_t key_size, size_t value_size, const HTConcurrentConfig *config);
+HTConcurrent *_ht_concurrent_create(size_t key_size, size_t value_size, size_t stripes, const HTConfig *config);
+HTConcurrent *_ht_concurrent_create_with(size_t key_size, size_t value_size, const HTConcurrentConfig *config);
+// takes type of key, and type of value
+#define ht_concurrent_create(key_size, value_size, stripes) _ht_concurrent_create(sizeof(key_size), sizeof(value_size), stripes, NULL)
+#define ht_concurrent_create_with(key_size, value_size, config) _ht_concurrent_create_with(sizeof(key_size), sizeof(value_size), config)
+void ht_concurrent_deinit(HTConcurrent *ct);
+void _ht_concurrent_destroy(HTConcurrent **ct);
+#define ht_concurrent_destroy(ct) _ht_concurrent_destroy(&ct);
+
+bool ht_concurrent_put(HTConcurrent *ct, const void *key, const void *value);
+// values are copied out under the stripe lock or inside an epoch read section,
+// a pointer into the table could be reused by another thread right after
+bool ht_concurrent_get(HTConcurrent *ct, const void *key, void *out_value);
+bool ht_concurrent_contains(HTConcurrent *ct, const void *key);
+// returns whether the key was present
+bool ht_concurrent_delete(HTConcurrent *ct, const void *key);
+bool ht_concurrent_resize(HTConcurrent *ct, size_t new_cap);
+void ht_concurrent_clear(HTConcurrent *ct);
+size_t ht_concurrent_count(HTConcurrent *ct);
+
+#endif // HT_CONCURRENT_H
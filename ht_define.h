@@ -0,0 +1,150 @@
+#ifndef HT_DEFINE_H
+#define HT_DEFINE_H
+
+// Type specialized chained tables. HT_DEFINE(name, K, V, hash_key, key_eq) emits a table
+// type `name` wrapping a Hashtable and inline name_put, name_get, name_find,
+// name_contains and name_delete taking keys and values by value. The bodies are
+// the chained algorithms of hashtable.c with the key size, value offset, hash
+// and comparison known at compile time, so an int key costs one 4 byte compare.
+// Values are copied by assignment and keys by a memcpy of constant size, which
+// compiles to a plain load or store.
+//
+// K and V must be assignable types, no arrays. hash_key(key) returns a uint64_t
+// and key_eq(a, b) is true for equal keys, both may be macros. The embedded
+// Hashtable stays a normal HT_CHAINED table with power of two buckets, so
+// ht_count, ht_clear, ht_stats, iterators and ht_foreach work on &t->ht.
+// The generic lookups, ht_find and friends, hash through the same hash but
+// compare key bytes, they agree with name_find when key_eq does too.
+#include <assert.h>
+#include "hashtable.h"
+#include "ht_internal.h"
+#include "xxhash/xxhash.h"
+
+// hash and eq for HT_DEFINE
+static inline uint64_t ht_mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDull;
+    x ^= x >> 33;
+    x *= 0xC4CEB9FE1A85EC53ull;
+    x ^= x >> 33;
+    return x;
+}
+#define HT_HASH_INTEGER(key) ht_mix64((uint64_t)(key))
+#define HT_HASH_BYTES(key) XXH3_64bits(&(key), sizeof(key))
+#define HT_EQ_SCALAR(a, b) ((a) == (b))
+#define HT_EQ_BYTES(a, b) (memcmp(&(a), &(b), sizeof(a)) == 0)
+
+// the value offset ht_init_with picks, computed at compile time
+#define HT_TYPE_ALIGN(size) \
+    (((size) & (~(size) + 1)) > _Alignof(max_align_t) ? _Alignof(max_align_t) : ((size) & (~(size) + 1)))
+#define HT_VALUE_OFFSET(K, V) ((sizeof(K) + HT_TYPE_ALIGN(sizeof(V)) - 1) & ~(HT_TYPE_ALIGN(sizeof(V)) - 1))
+
+#define HT_DEFINE(name, K, V, hash_key, key_eq)                                                     \
+typedef struct name {                                                                               \
+    Hashtable ht;                                                                                   \
+} name;                                                                                             \
+                                                                                                    \
+static inline uint64_t name##_hash(K key) {                                                         \
+    return hash_key(key);                                                                           \
+}                                                                                                   \
+                                                                                                    \
+/* hash_fn of the embedded table, for code going through the generic API */                        \
+static inline uint64_t name##_hash_fn(const void *key, size_t key_size) {                           \
+    (void)key_size;                                                                                 \
+    K k;                                                                                            \
+    memcpy(&k, key, sizeof(K));                                                                     \
+    return name##_hash(k);                                                                          \
+}                                                                                                   \
+                                                                                                    \
+static inline bool name##_init(name *t) {                                                           \
+    HTConfig config = { .backend = HT_CHAINED, .hash = HT_HASH_CUSTOM,                              \
+                        .hash_fn = name##_hash_fn, .cap_policy = HT_CAP_POW2 };                     \
+    bool ok = ht_init_with(&t->ht, sizeof(K), sizeof(V), &config);                                  \
+    /* the inline paths place values where the generic ones do */                                   \
+    assert(!ok || HT_VALUE_OFFSET(K, V) == t->ht.value_offset);                                     \
+    return ok;                                                                                      \
+}                                                                                                   \
+                                                                                                    \
+static inline void name##_deinit(name *t) {                                                         \
+    ht_deinit(&t->ht);                                                                              \
+}                                                                                                   \
+                                                                                                    \
+static inline size_t name##_count(const name *t) {                                                  \
+    return t->ht.count;                                                                             \
+}                                                                                                   \
+                                                                                                    \
+/* link pointing at the node holding key, or NULL */                                               \
+static inline HTNode **name##_find_link(const name *t, K key, uint64_t key_hash) {                  \
+    const Hashtable *ht = &t->ht;                                                                   \
+    HT_COUNT(ht, lookups, 1);                                                                       \
+    HTNode **link = &ht->arr[bucket_index(ht, key_hash, ht->arr_cap)];                              \
+    for (; *link != NULL; link = &(*link)->next) {                                                  \
+        HT_COUNT(ht, probes, 1);                                                                    \
+        if ((*link)->stored_hash == key_hash) {                                                     \
+            K node_key;                                                                             \
+            memcpy(&node_key, ht_node_key(*link), sizeof(K));                                       \
+            if (key_eq(node_key, key)) {                                                            \
+                return link;                                                                        \
+            }                                                                                       \
+        }                                                                                           \
+    }                                                                                               \
+    return NULL;                                                                                    \
+}                                                                                                   \
+                                                                                                    \
+static inline V *name##_value(HTNode *node) {                                                       \
+    return (V *)(void *)((unsigned char *)node->data + HT_VALUE_OFFSET(K, V));                      \
+}                                                                                                   \
+                                                                                                    \
+static inline bool name##_put(name *t, K key, V value) {                                            \
+    Hashtable *ht = &t->ht;                                                                         \
+    uint64_t key_hash = name##_hash(key);                                                           \
+    if ((float)ht->count / ht->arr_cap >= 0.75 && !ht_resize(ht, 2 * ht->arr_cap)) {                \
+        return false;                                                                               \
+    }                                                                                               \
+    HTNode **link = name##_find_link(t, key, key_hash);                                             \
+    if (link) {                                                                                     \
+        *name##_value(*link) = value;                                                               \
+        return true;                                                                                \
+    }                                                                                               \
+    HTNode *node = ht_slab_alloc(&ht->slab);                                                        \
+    if (!node) {                                                                                    \
+        return false;                                                                               \
+    }                                                                                               \
+    memcpy(ht_node_key(node), &key, sizeof(K));                                                     \
+    *name##_value(node) = value;                                                                    \
+    ht_link_node(ht, node, key_hash);                                                               \
+    return true;                                                                                    \
+}                                                                                                   \
+                                                                                                    \
+/* pointer to the value inside the table, valid until the entry is deleted or the table cleared */ \
+static inline V *name##_find(const name *t, K key) {                                                \
+    HTNode **link = name##_find_link(t, key, name##_hash(key));                                     \
+    return link ? name##_value(*link) : NULL;                                                       \
+}                                                                                                   \
+                                                                                                    \
+static inline bool name##_get(const name *t, K key, V *out_value) {                                 \
+    V *value = name##_find(t, key);                                                                 \
+    if (value) {                                                                                    \
+        *out_value = *value;                                                                        \
+    }                                                                                               \
+    return value != NULL;                                                                           \
+}                                                                                                   \
+                                                                                                    \
+static inline bool name##_contains(const name *t, K key) {                                          \
+    return name##_find(t, key) != NULL;                                                             \
+}                                                                                                   \
+                                                                                                    \
+/* returns whether the key was present */                                                          \
+static inline bool name##_delete(name *t, K key) {                                                  \
+    HTNode **link = name##_find_link(t, key, name##_hash(key));                                     \
+    if (!link) {                                                                                    \
+        return false;                                                                               \
+    }                                                                                               \
+    HTNode *node = *link;                                                                           \
+    *link = node->next;                                                                             \
+    ht_slab_free(&t->ht.slab, node);                                                                \
+    t->ht.count--;                                                                                  \
+    return true;                                                                                    \
+}
+
+#endif // HT_DEFINE_H
@@ -0,0 +1,95 @@
+#include "ht_internal.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+
+// Epoch based reclamation shared by every HT_READ_EPOCH table in the process.
+// A reader announces the global epoch it saw in its thread's slot on entry and
+// clears it on exit, neither takes a lock or an atomic read-modify-write. The
+// global epoch only advances once every reader inside a section has announced
+// the current one, so memory unlinked while the epoch was e can no longer be
+// reached by anyone once the epoch has reached e + 2.
+
+#define EPOCH_SLOTS 256 // threads that can be registered at once
+
+typedef struct EpochSlot {
+    _Atomic uint64_t epoch; // 0 outside a read section
+    _Atomic bool used;
+} __attribute__((aligned(64))) EpochSlot;
+
+static EpochSlot slots[EPOCH_SLOTS];
+static _Atomic uint64_t global_epoch = 1;
+static _Thread_local EpochSlot *thread_slot;
+static pthread_key_t slot_key;
+static pthread_once_t slot_key_once = PTHREAD_ONCE_INIT;
+
+// runs at thread exit, the slot can go to a new thread
+static void release_slot(void *slot) {
+    atomic_store(&((EpochSlot *)slot)->used, false);
+}
+
+static void make_slot_key(void) {
+    pthread_key_create(&slot_key, release_slot);
+}
+
+// a thread claims a slot the first time it reads, waiting for one to be
+// released if EPOCH_SLOTS threads already hold one
+static EpochSlot *claim_slot(void) {
+    pthread_once(&slot_key_once, make_slot_key);
+    while (true) {
+        for (size_t i = 0; i < EPOCH_SLOTS; i++) {
+            bool expected = false;
+            if (!atomic_load_explicit(&slots[i].used, memory_order_relaxed) &&
+                atomic_compare_exchange_strong(&slots[i].used, &expected, true)) {
+                pthread_setspecific(slot_key, &slots[i]);
+                return &slots[i];
+            }
+        }
+        sched_yield();
+    }
+}
+
+void ht_epoch_enter(void) {
+    if (!thread_slot) {
+        thread_slot = claim_slot();
+    }
+    atomic_store_explicit(&thread_slot->epoch, atomic_load_explicit(&global_epoch, memory_order_relaxed), memory_order_relaxed);
+    // the announcement has to be visible before any pointer of the table is read
+    atomic_thread_fence(memory_order_seq_cst);
+}
+
+void ht_epoch_exit(void) {
+    atomic_store_explicit(&thread_slot->epoch, 0, memory_order_release);
+}
+
+// epoch to tag memory with once it is unlinked
+uint64_t ht_epoch_now(void) {
+    atomic_thread_fence(memory_order_seq_cst);
+    return atomic_load(&global_epoch);
+}
+
+// moves the global epoch on if no reader is still in an older one, returns the
+// epoch after the attempt
+uint64_t ht_epoch_advance(void) {
+    uint64_t epoch = ht_epoch_now();
+    for (size_t i = 0; i < EPOCH_SLOTS; i++) {
+        if (!atomic_load_explicit(&slots[i].used, memory_order_acquire)) {
+            continue;
+        }
+        uint64_t seen = atomic_load_explicit(&slots[i].epoch, memory_order_acquire);
+        if (seen != 0 && seen != epoch) {
+            return epoch;
+        }
+    }
+    atomic_compare_exchange_strong(&global_epoch, &epoch, epoch + 1);
+    return atomic_load(&global_epoch);
+}
+
+// waits until everything unlinked before the call is unreachable, the calling
+// thread must not be inside a read section itself
+void ht_epoch_synchronize(void) {
+    uint64_t target = ht_epoch_now() + 2;
+    while (ht_epoch_advance() < target) {
+        sched_yield();
+    }
+}
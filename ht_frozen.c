@@ -0,0 +1,234 @@
+#include "ht_frozen.h"
+#include "ht_internal.h"
+#include <assert.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Image layout, native byte order, every offset from the start of the file:
+//   HTFrozenHeader
+//   uint64_t bucket_start[bucket_count + 1]
+//   uint64_t hashes[count]       at hashes_offset, cache line aligned
+//   slots[count]                 at slots_offset, cache line aligned
+// Entries are grouped by bucket in bucket order. A slot has the key at its
+// start and the value at value_offset, with the alignment of a Hashtable slot.
+
+#define HT_FROZEN_MAGIC "HTFROZEN"
+#define HT_FROZEN_VERSION 1
+#define HT_FROZEN_MIN_BITS 4 // at least 16 buckets
+
+typedef struct HTFrozenHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t hash_kind;
+    uint64_t key_size;
+    uint64_t value_size;
+    uint64_t value_offset;
+    uint64_t entry_size;
+    uint64_t count;
+    uint64_t bucket_bits;
+    uint64_t hashes_offset;
+    uint64_t slots_offset;
+    uint64_t file_size;
+} HTFrozenHeader;
+
+static size_t align64(size_t x) {
+    return (x + 63) & ~(size_t)63;
+}
+
+// same Fibonacci multiply-shift as bucket_index of an HT_CAP_POW2 table
+static size_t frozen_bucket(uint64_t key_hash, unsigned int bucket_bits) {
+    return (size_t)((key_hash * 0x9E3779B97F4A7C15ull) >> (64 - bucket_bits));
+}
+
+typedef struct FreezeBuild {
+    const HTFrozenHeader *header;
+    uint64_t *bucket_start;
+    uint64_t *hashes;
+    unsigned char *slots;
+} FreezeBuild;
+
+static void count_entry(uint64_t key_hash, const void *key, const void *value, void *ctx) {
+    FreezeBuild *b = ctx;
+    b->bucket_start[frozen_bucket(key_hash, b->header->bucket_bits) + 1]++;
+}
+
+// bucket_start[b] is the next free index of bucket b while entries are placed
+static void place_entry(uint64_t key_hash, const void *key, const void *value, void *ctx) {
+    FreezeBuild *b = ctx;
+    uint64_t idx = b->bucket_start[frozen_bucket(key_hash, b->header->bucket_bits)]++;
+    unsigned char *slot = b->slots + idx * b->header->entry_size;
+    b->hashes[idx] = key_hash;
+    memcpy(slot, key, b->header->key_size);
+    memcpy(slot + b->header->value_offset, value, b->header->value_size);
+}
+
+// The image is written through a shared mapping of path.tmp, which is renamed
+// over path once complete so readers never map a half written image.
+bool ht_freeze(const Hashtable *ht, const char *path) {
+    assert(ht); assert(path);
+    if (ht->key_size == HT_VARLEN_KEY) {
+        fprintf(stderr, "ht_freeze needs a fixed key_size\n");
+        return false;
+    }
+    HTFrozenHeader header = {
+        .magic = HT_FROZEN_MAGIC,
+        .version = HT_FROZEN_VERSION,
+        .hash_kind = ht->hash_kind,
+        .key_size = ht->key_size,
+        .value_size = ht->value_size,
+        .value_offset = ht->value_offset,
+        .entry_size = ht->entry_size,
+        .count = ht->count,
+        .bucket_bits = HT_FROZEN_MIN_BITS,
+    };
+    // one to two entries per bucket, their hashes sit side by side in one cache line
+    while (((size_t)1 << header.bucket_bits) < ht->count / 2) {
+        header.bucket_bits++;
+    }
+    size_t bucket_count = (size_t)1 << header.bucket_bits;
+    header.hashes_offset = align64(sizeof(HTFrozenHeader) + (bucket_count + 1) * sizeof(uint64_t));
+    header.slots_offset = align64(header.hashes_offset + ht->count * sizeof(uint64_t));
+    header.file_size = header.slots_offset + ht->count * ht->entry_size;
+
+    size_t tmp_len = strlen(path) + sizeof(".tmp");
+    char *tmp_path = (char *)malloc(tmp_len);
+    if (!tmp_path) {
+        fprintf(stderr, "Failed to allocate path during ht_freeze\n");
+        return false;
+    }
+    snprintf(tmp_path, tmp_len, "%s.tmp", path);
+    int fd = open(tmp_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || ftruncate(fd, (off_t)header.file_size) != 0) {
+        fprintf(stderr, "Failed to create %s during ht_freeze\n", tmp_path);
+        if (fd >= 0) {
+            close(fd);
+            remove(tmp_path);
+        }
+        free(tmp_path);
+        return false;
+    }
+    unsigned char *map = mmap(NULL, header.file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Failed to map %s during ht_freeze\n", tmp_path);
+        remove(tmp_path);
+        free(tmp_path);
+        return false;
+    }
+
+    // the file starts out zeroed, so the counts start at zero
+    memcpy(map, &header, sizeof(header));
+    FreezeBuild build = {
+        .header = (const HTFrozenHeader *)map,
+        .bucket_start = (uint64_t *)(map + sizeof(HTFrozenHeader)),
+        .hashes = (uint64_t *)(map + header.hashes_offset),
+        .slots = map + header.slots_offset,
+    };
+    ht_foreach_hashed(ht, count_entry, &build);
+    for (size_t b = 0; b < bucket_count; b++) {
+        build.bucket_start[b + 1] += build.bucket_start[b];
+    }
+    ht_foreach_hashed(ht, place_entry, &build);
+    // placing advanced every start to the start of the next bucket
+    memmove(build.bucket_start + 1, build.bucket_start, bucket_count * sizeof(uint64_t));
+    build.bucket_start[0] = 0;
+
+    bool ok = munmap(map, header.file_size) == 0 && rename(tmp_path, path) == 0;
+    if (!ok) {
+        fprintf(stderr, "Failed to write %s during ht_freeze\n", path);
+        remove(tmp_path);
+    }
+    free(tmp_path);
+    return ok;
+}
+
+bool ht_frozen_open(HTFrozen *fz, const char *path, HTHashFunc hash_fn) {
+    assert(fz); assert(path);
+    memset(fz, 0, sizeof(HTFrozen));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Failed to open %s during ht_frozen_open\n", path);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(HTFrozenHeader)) {
+        fprintf(stderr, "%s is not a frozen hashtable\n", path);
+        close(fd);
+        return false;
+    }
+    const unsigned char *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Failed to map %s during ht_frozen_open\n", path);
+        return false;
+    }
+    const HTFrozenHeader *header = (const HTFrozenHeader *)map;
+    if (memcmp(header->magic, HT_FROZEN_MAGIC, sizeof(header->magic)) != 0
+        || header->version != HT_FROZEN_VERSION || header->file_size != (uint64_t)st.st_size
+        || header->bucket_bits < HT_FROZEN_MIN_BITS || header->bucket_bits > 63) {
+        fprintf(stderr, "%s is not a frozen hashtable\n", path);
+        munmap((void *)map, (size_t)st.st_size);
+        return false;
+    }
+    HTHashKind kind = (HTHashKind)header->hash_kind;
+    fz->hash_fn = kind == HT_HASH_CUSTOM ? hash_fn : ht_hash_for_kind(kind);
+    if (!fz->hash_fn) {
+        fprintf(stderr, "ht_frozen_open requires a hash_fn when the hash kind is HT_HASH_CUSTOM\n");
+        munmap((void *)map, (size_t)st.st_size);
+        return false;
+    }
+    fz->map = map;
+    fz->map_size = (size_t)st.st_size;
+    fz->bucket_start = (const uint64_t *)(map + sizeof(HTFrozenHeader));
+    fz->hashes = (const uint64_t *)(map + header->hashes_offset);
+    fz->slots = map + header->slots_offset;
+    fz->count = header->count;
+    fz->bucket_bits = (unsigned int)header->bucket_bits;
+    fz->key_size = header->key_size;
+    fz->value_size = header->value_size;
+    fz->value_offset = header->value_offset;
+    fz->entry_size = header->entry_size;
+    fz->hash_kind = kind;
+    return true;
+}
+
+void ht_frozen_close(HTFrozen *fz) {
+    if (fz && fz->map) {
+        munmap((void *)fz->map, fz->map_size);
+        memset(fz, 0, sizeof(HTFrozen));
+    }
+}
+
+const void *ht_frozen_find(const HTFrozen *fz, const void *key) {
+    assert(fz); assert(key);
+    uint64_t key_hash = fz->hash_fn(key, fz->key_size);
+    size_t bucket = frozen_bucket(key_hash, fz->bucket_bits);
+    for (uint64_t i = fz->bucket_start[bucket]; i < fz->bucket_start[bucket + 1]; i++) {
+        const unsigned char *slot = fz->slots + i * fz->entry_size;
+        if (fz->hashes[i] == key_hash && memcmp(slot, key, fz->key_size) == 0) {
+            return slot + fz->value_offset;
+        }
+    }
+    return NULL;
+}
+
+bool ht_frozen_get(const HTFrozen *fz, const void *key, void *out_value) {
+    assert(out_value);
+    const void *value = ht_frozen_find(fz, key);
+    if (!value) {
+        return false;
+    }
+    memcpy(out_value, value, fz->value_size);
+    return true;
+}
+
+bool ht_frozen_contains(const HTFrozen *fz, const void *key) {
+    return ht_frozen_find(fz, key) != NULL;
+}
+
+size_t ht_frozen_count(const HTFrozen *fz) {
+    assert(fz);
+    return fz->count;
+}
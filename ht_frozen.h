@@ -0,0 +1,42 @@
+#ifndef HT_FROZEN_H
+#define HT_FROZEN_H
+
+#include "hashtable.h"
+
+// Read only table image built once by ht_freeze and queried in place through
+// mmap. The image holds no pointers, only offsets from its start, so every
+// process mapping the same file shares its pages through the page cache and
+// opening it allocates nothing per entry. Lookups hash the key, pick one of a
+// power of two number of buckets and scan that bucket's run of cached hashes,
+// the key is only compared on a hash match.
+typedef struct HTFrozen {
+    const unsigned char *map;
+    size_t map_size;
+    const uint64_t *bucket_start; // bucket_count + 1 entry indexes, bucket b is [start[b], start[b + 1])
+    const uint64_t *hashes; // cached hash of each entry
+    const unsigned char *slots; // entries laid out like Hashtable slots, entry_size apart
+    size_t count;
+    unsigned int bucket_bits;
+    size_t key_size;
+    size_t value_size;
+    size_t value_offset;
+    size_t entry_size;
+    HTHashKind hash_kind;
+    HTHashFunc hash_fn;
+} HTFrozen;
+
+// writes the entries of ht as a frozen image to path, any backend
+bool ht_freeze(const Hashtable *ht, const char *path);
+// maps the image at path, hash_fn is required when it was frozen from an
+// HT_HASH_CUSTOM table and ignored otherwise. The file is trusted to have been
+// written by ht_freeze, only its header is checked.
+bool ht_frozen_open(HTFrozen *fz, const char *path, HTHashFunc hash_fn);
+void ht_frozen_close(HTFrozen *fz);
+
+// pointer to the value inside the mapping, valid until ht_frozen_close
+const void *ht_frozen_find(const HTFrozen *fz, const void *key);
+bool ht_frozen_get(const HTFrozen *fz, const void *key, void *out_value);
+bool ht_frozen_contains(const HTFrozen *fz, const void *key);
+size_t ht_frozen_count(const HTFrozen *fz);
+
+#endif // HT_FROZEN_H
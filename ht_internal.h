@@ -0,0 +1,126 @@
+#ifndef HT_INTERNAL_H
+#define HT_INTERNAL_H
+
+// Declarations shared between hashtable.c and the backend translation units,
+// these are not part of the public API in hashtable.h
+#include "hashtable.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ht_slot_at(ht, idx) ((ht)->slots + (size_t)(idx) * (ht)->entry_size)
+#define ht_slot_value(ht, slot) ((void *)((slot) + (ht)->value_offset))
+// whether an open addressing slot holds an entry, HT_SWISS marks free slots with
+// the high control bit and HT_ROBIN_HOOD with a probe distance of 0
+#define ht_slot_full(ht, idx) ((ht)->backend == HT_SWISS ? !((ht)->ctrl[idx] & 0x80) : (ht)->ctrl[idx] != 0)
+
+// HT_VARLEN_KEY nodes hold the value at the start of data followed by an
+// HTStrKey. A key of up to HT_STR_INLINE bytes is stored whole in head and
+// tail, a longer one keeps its first 12 bytes in head and spills to a buffer of
+// its own holding the length, the key bytes and a NUL. Either way the key bytes
+// are NUL terminated and right after a uint32_t length.
+#define HT_STR_INLINE 19 // 16 character ids and their NUL fit in the node
+
+typedef struct HTStrKey {
+    uint32_t len;
+    char head[12]; // first bytes of the key, NUL padded, the first 8 are its fingerprint
+    union {
+        char tail[8]; // the rest of an inline key, head and tail are contiguous
+        char *spill; // key bytes of a longer key
+    };
+} HTStrKey;
+
+static inline size_t ht_str_key_offset(const Hashtable *ht) {
+    return (ht->value_size + __alignof__(HTStrKey) - 1) & ~(__alignof__(HTStrKey) - 1);
+}
+#define ht_str_key(ht, node) ((HTStrKey *)((unsigned char *)(node)->data + ht_str_key_offset(ht)))
+#define ht_str_key_bytes(k) ((k)->len <= HT_STR_INLINE ? (char *)(k) + offsetof(HTStrKey, head) : (k)->spill)
+// key of a chained node in either key mode
+#define ht_chained_key(ht, node) ((ht)->key_size == HT_VARLEN_KEY ? (void *)ht_str_key_bytes(ht_str_key(ht, node)) : ht_node_key(node))
+
+// bucket of key_hash among cap buckets. Power of two capacities use Fibonacci
+// multiply-shift, which takes the top bits of the product so every hash bit
+// affects the index, and avoids the integer division of the prime modulo
+static inline size_t bucket_index(const Hashtable *ht, uint64_t key_hash, size_t cap) {
+    if (ht->cap_policy == HT_CAP_POW2) {
+        return (size_t)((key_hash * 0x9E3779B97F4A7C15ull) >> (64 - __builtin_ctzll(cap)));
+    }
+    return key_hash % cap;
+}
+
+// bumps one of ht's HTCounters, compiled out unless HT_STATS is defined. Lookups
+// take a const table, the counters are bookkeeping and not part of its state
+#ifdef HT_STATS
+#define HT_COUNT(ht, counter, n) (((Hashtable *)(ht))->counters.counter += (n))
+#else
+#define HT_COUNT(ht, counter, n) ((void)0)
+#endif
+
+// built in hash function of kind, NULL for HT_HASH_CUSTOM
+HTHashFunc ht_hash_for_kind(HTHashKind kind);
+
+// adds a chain or probe length to the histogram and max of out
+void ht_stats_record(HTStats *out, size_t len);
+
+// epoch based reclamation behind HT_READ_EPOCH concurrent tables, see ht_epoch.c
+void ht_epoch_enter(void);
+void ht_epoch_exit(void);
+uint64_t ht_epoch_now(void);
+uint64_t ht_epoch_advance(void);
+void ht_epoch_synchronize(void);
+
+// ht_put, ht_find and ht_delete for callers that already hashed the key with
+// ht->hash_fn, such as front ends picking a table by hash
+bool ht_put_hashed(Hashtable *ht, const void *key, const void *value, uint64_t key_hash);
+void *ht_find_hashed(const Hashtable *ht, const void *key, uint64_t key_hash);
+bool ht_delete_hashed(Hashtable *ht, const void *key, uint64_t key_hash);
+void *ht_get_or_insert_hashed(Hashtable *ht, const void *key, uint64_t key_hash, bool *inserted);
+// HT_CHAINED, pushes a filled in node on its bucket without looking for its key
+void ht_link_node(Hashtable *ht, HTNode *node, uint64_t key_hash);
+
+// full table scans, ht_scan_prepare finishes a running incremental rehash and
+// ht_foreach_range then visits buckets or slots [lo, hi)
+void ht_scan_prepare(const Hashtable *ht);
+void ht_foreach_range(const Hashtable *ht, size_t lo, size_t hi, HTForeachFunc fn, void *ctx);
+// every entry with its cached hash, finishing a running incremental rehash first
+typedef void (*HTHashedFunc)(uint64_t key_hash, const void *key, const void *value, void *ctx);
+void ht_foreach_hashed(const Hashtable *ht, HTHashedFunc fn, void *ctx);
+
+// node slab of HT_CHAINED tables
+void ht_slab_init(HTSlab *slab, size_t node_size);
+HTNode *ht_slab_alloc(HTSlab *slab);
+HTNode *ht_slab_alloc_run(HTSlab *slab, size_t n);
+void ht_slab_free(HTSlab *slab, HTNode *node);
+void ht_slab_reset(HTSlab *slab);
+void ht_slab_deinit(HTSlab *slab);
+
+// HT_SWISS, the hash of the key is computed by the caller
+bool ht_swiss_init(Hashtable *ht, size_t min_cap);
+bool ht_swiss_put(Hashtable *ht, const void *key, const void *value, uint64_t key_hash);
+void *ht_swiss_get_or_insert(Hashtable *ht, const void *key, uint64_t key_hash, bool *inserted);
+void *ht_swiss_find(const Hashtable *ht, const void *key, uint64_t key_hash);
+void ht_swiss_prefetch(const Hashtable *ht, uint64_t key_hash);
+bool ht_swiss_delete(Hashtable *ht, const void *key, uint64_t key_hash);
+bool ht_swiss_resize(Hashtable *ht, size_t new_cap);
+void ht_swiss_clear(Hashtable *ht);
+void ht_swiss_deinit(Hashtable *ht);
+void ht_swiss_stats(const Hashtable *ht, HTStats *out);
+
+// HT_ROBIN_HOOD
+bool ht_robin_hood_init(Hashtable *ht, size_t min_cap);
+bool ht_robin_hood_put(Hashtable *ht, const void *key, const void *value, uint64_t key_hash);
+void *ht_robin_hood_get_or_insert(Hashtable *ht, const void *key, uint64_t key_hash, bool *inserted);
+void *ht_robin_hood_find(const Hashtable *ht, const void *key, uint64_t key_hash);
+void ht_robin_hood_prefetch(const Hashtable *ht, uint64_t key_hash);
+bool ht_robin_hood_delete(Hashtable *ht, const void *key, uint64_t key_hash);
+bool ht_robin_hood_resize(Hashtable *ht, size_t new_cap);
+void ht_robin_hood_clear(Hashtable *ht);
+void ht_robin_hood_deinit(Hashtable *ht);
+void ht_robin_hood_stats(const Hashtable *ht, HTStats *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HT_INTERNAL_H
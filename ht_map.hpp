@@ -0,0 +1,465 @@
+#ifndef HT_MAP_HPP
+#define HT_MAP_HPP
+
+// C++ front end of a chained Hashtable. ht::map<K, V, Hash, Eq> constructs its
+// std::pair<const K, V> entries in place in the slab nodes of an HT_CHAINED
+// table with power of two buckets. Nodes never move, so references and
+// pointers to entries stay valid until the entry is erased, and keys and values
+// are moved or constructed, never memcpy'd, which allows move only values.
+// Keys are hashed by Hash and compared by Eq; the engine's own hash function is
+// never called. When both are transparent, as ht::hash<std::string> and
+// std::equal_to<> are, find, contains, count and at take any comparable key
+// type, so a std::string_view looks up a std::string key without allocating.
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "ht_internal.h"
+#include "xxhash/xxhash.h"
+
+namespace ht {
+
+// XXH3 of the bytes of a key, for key types whose equal values have equal
+// bytes: integers, enums, pointers and structs without padding
+template <class K>
+struct hash {
+    static_assert(std::has_unique_object_representations_v<K>,
+                  "ht::hash<K> hashes the bytes of K, pass ht::map a Hash for this key type");
+    uint64_t operator()(const K &key) const noexcept {
+        return XXH3_64bits(&key, sizeof(K));
+    }
+};
+
+// XXH3 of the characters, for std::string, std::string_view and C strings alike
+template <>
+struct hash<std::string> {
+    using is_transparent = void;
+    uint64_t operator()(std::string_view key) const noexcept {
+        return XXH3_64bits(key.data(), key.size());
+    }
+};
+
+template <>
+struct hash<std::string_view> : hash<std::string> {};
+
+template <class K>
+using default_equal = std::conditional_t<std::is_same_v<K, std::string> || std::is_same_v<K, std::string_view>,
+                                         std::equal_to<>, std::equal_to<K>>;
+
+template <class K, class V, class Hash = ht::hash<K>, class Eq = default_equal<K>>
+class map {
+public:
+    using key_type = K;
+    using mapped_type = V;
+    using value_type = std::pair<const K, V>;
+    using size_type = size_t;
+    using difference_type = ptrdiff_t;
+    using hasher = Hash;
+    using key_equal = Eq;
+    using reference = value_type &;
+    using const_reference = const value_type &;
+
+    // the node data holds a value_type, the engine only sees its size
+    static_assert(alignof(value_type) <= alignof(max_align_t), "over aligned keys and values are not supported");
+
+    template <bool Const>
+    class basic_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = map::value_type;
+        using difference_type = ptrdiff_t;
+        using pointer = std::conditional_t<Const, const value_type *, value_type *>;
+        using reference = std::conditional_t<Const, const value_type &, value_type &>;
+
+        basic_iterator() = default;
+        // iterator converts to const_iterator
+        template <bool C = Const, class = std::enable_if_t<C>>
+        basic_iterator(const basic_iterator<false> &other) : ht_(other.ht_), bucket_(other.bucket_), node_(other.node_) {}
+
+        reference operator*() const { return *map::entry(node_); }
+        pointer operator->() const { return map::entry(node_); }
+
+        basic_iterator &operator++() {
+            node_ = node_->next;
+            while (!node_ && ++bucket_ < ht_->arr_cap) {
+                node_ = ht_->arr[bucket_];
+            }
+            return *this;
+        }
+        basic_iterator operator++(int) {
+            basic_iterator old = *this;
+            ++*this;
+            return old;
+        }
+
+        friend bool operator==(const basic_iterator &a, const basic_iterator &b) { return a.node_ == b.node_; }
+        friend bool operator!=(const basic_iterator &a, const basic_iterator &b) { return a.node_ != b.node_; }
+
+    private:
+        friend class map;
+        template <bool> friend class basic_iterator;
+        basic_iterator(const Hashtable *ht, size_t bucket, HTNode *node) : ht_(ht), bucket_(bucket), node_(node) {}
+
+        const Hashtable *ht_ = nullptr;
+        size_t bucket_ = 0;
+        HTNode *node_ = nullptr; // nullptr at the end
+    };
+    using iterator = basic_iterator<false>;
+    using const_iterator = basic_iterator<true>;
+
+    // an empty map allocates nothing, the table is set up by the first insert
+    map() = default;
+    explicit map(size_t n, const Hash &hash = Hash(), const Eq &eq = Eq()) : hash_(hash), eq_(eq) {
+        reserve(n);
+    }
+    map(std::initializer_list<value_type> entries) : map(entries.size()) {
+        for (const value_type &entry : entries) {
+            insert(entry);
+        }
+    }
+
+    // copies link every entry under the hash cached in its source node
+    map(const map &other) : map(other.size(), other.hash_, other.eq_) {
+        for (const_iterator it = other.begin(); it != other.end(); ++it) {
+            link(it.node_->stored_hash, *it);
+        }
+    }
+    map(map &&other) noexcept : ht_(other.ht_), hash_(std::move(other.hash_)), eq_(std::move(other.eq_)) {
+        other.ht_ = Hashtable{};
+    }
+    map &operator=(const map &other) {
+        if (this != &other) {
+            map copy(other);
+            swap(copy);
+        }
+        return *this;
+    }
+    map &operator=(map &&other) noexcept {
+        if (this != &other) {
+            release();
+            ht_ = other.ht_;
+            other.ht_ = Hashtable{};
+            hash_ = std::move(other.hash_);
+            eq_ = std::move(other.eq_);
+        }
+        return *this;
+    }
+    ~map() { release(); }
+
+    void swap(map &other) noexcept {
+        std::swap(ht_, other.ht_);
+        std::swap(hash_, other.hash_);
+        std::swap(eq_, other.eq_);
+    }
+
+    iterator begin() noexcept { return first<iterator>(); }
+    iterator end() noexcept { return iterator(); }
+    const_iterator begin() const noexcept { return first<const_iterator>(); }
+    const_iterator end() const noexcept { return const_iterator(); }
+    const_iterator cbegin() const noexcept { return begin(); }
+    const_iterator cend() const noexcept { return end(); }
+
+    size_t size() const noexcept { return ht_.count; }
+    bool empty() const noexcept { return ht_.count == 0; }
+    size_t bucket_count() const noexcept { return ht_.arr_cap; }
+    hasher hash_function() const { return hash_; }
+    key_equal key_eq() const { return eq_; }
+    // the underlying table, for ht_stats. Its keys are C++ objects the C lookups can't compare.
+    const Hashtable *table() const noexcept { return &ht_; }
+
+    // sizes the buckets for n entries so inserting them does not grow the table
+    void reserve(size_t n) {
+        init();
+        if (!ht_reserve(&ht_, n)) {
+            throw std::bad_alloc();
+        }
+    }
+
+    // destroys every entry and keeps the buckets and slab chunks for reuse
+    void clear() noexcept {
+        if (!ht_.arr) {
+            return;
+        }
+        destroy_entries();
+        ht_clear(&ht_);
+    }
+
+    // Constructs the entry in a new node from args, then looks up its key. When
+    // the key is present the new entry is destroyed and the existing one returned.
+    template <class... Args>
+    std::pair<iterator, bool> emplace(Args &&...args) {
+        init();
+        HTNode *node = construct(std::forward<Args>(args)...);
+        const K &key = entry(node)->first;
+        uint64_t key_hash = hash_(key);
+        if (HTNode **link = find_link(key, key_hash)) {
+            entry(node)->~value_type();
+            ht_slab_free(&ht_.slab, node);
+            return {at_node(*link), false};
+        }
+        grow(node);
+        ht_link_node(&ht_, node, key_hash);
+        return {at_node(node), true};
+    }
+
+    // constructs V from args only when key is absent
+    template <class... Args>
+    std::pair<iterator, bool> try_emplace(const K &key, Args &&...args) {
+        return emplace_key(key, std::forward<Args>(args)...);
+    }
+    template <class... Args>
+    std::pair<iterator, bool> try_emplace(K &&key, Args &&...args) {
+        return emplace_key(std::move(key), std::forward<Args>(args)...);
+    }
+
+    std::pair<iterator, bool> insert(const value_type &value) { return try_emplace(value.first, value.second); }
+    std::pair<iterator, bool> insert(value_type &&value) { return try_emplace(value.first, std::move(value.second)); }
+
+    template <class M>
+    std::pair<iterator, bool> insert_or_assign(const K &key, M &&value) {
+        std::pair<iterator, bool> result = try_emplace(key, std::forward<M>(value));
+        if (!result.second) {
+            result.first->second = std::forward<M>(value);
+        }
+        return result;
+    }
+    template <class M>
+    std::pair<iterator, bool> insert_or_assign(K &&key, M &&value) {
+        std::pair<iterator, bool> result = try_emplace(std::move(key), std::forward<M>(value));
+        if (!result.second) {
+            result.first->second = std::forward<M>(value);
+        }
+        return result;
+    }
+
+    V &operator[](const K &key) { return try_emplace(key).first->second; }
+    V &operator[](K &&key) { return try_emplace(std::move(key)).first->second; }
+
+    // Lookups, the template overloads only take part when Hash and Eq are both
+    // transparent, like those of std::unordered_map since C++20
+    iterator find(const K &key) { return find_iter<iterator>(key); }
+    const_iterator find(const K &key) const { return find_iter<const_iterator>(key); }
+    template <class Q, class H = Hash, class E = Eq, class = typename H::is_transparent, class = typename E::is_transparent>
+    iterator find(const Q &key) {
+        return find_iter<iterator>(key);
+    }
+    template <class Q, class H = Hash, class E = Eq, class = typename H::is_transparent, class = typename E::is_transparent>
+    const_iterator find(const Q &key) const {
+        return find_iter<const_iterator>(key);
+    }
+
+    bool contains(const K &key) const { return lookup(key) != nullptr; }
+    template <class Q, class H = Hash, class E = Eq, class = typename H::is_transparent, class = typename E::is_transparent>
+    bool contains(const Q &key) const {
+        return lookup(key) != nullptr;
+    }
+    size_t count(const K &key) const { return contains(key); }
+    template <class Q, class H = Hash, class E = Eq, class = typename H::is_transparent, class = typename E::is_transparent>
+    size_t count(const Q &key) const {
+        return contains(key);
+    }
+
+    V &at(const K &key) { return checked(lookup(key)); }
+    const V &at(const K &key) const { return checked(lookup(key)); }
+    template <class Q, class H = Hash, class E = Eq, class = typename H::is_transparent, class = typename E::is_transparent>
+    V &at(const Q &key) {
+        return checked(lookup(key));
+    }
+    template <class Q, class H = Hash, class E = Eq, class = typename H::is_transparent, class = typename E::is_transparent>
+    const V &at(const Q &key) const {
+        return checked(lookup(key));
+    }
+
+    // returns the number of entries erased, 0 or 1
+    size_t erase(const K &key) {
+        if (ht_.count == 0) {
+            return 0;
+        }
+        HTNode **link = find_link(key, hash_(key));
+        if (!link) {
+            return 0;
+        }
+        unlink(link);
+        return 1;
+    }
+
+    // returns the iterator following pos
+    iterator erase(const_iterator pos) {
+        iterator next(pos.ht_, pos.bucket_, pos.node_);
+        ++next;
+        HTNode **link = &ht_.arr[pos.bucket_];
+        while (*link != pos.node_) {
+            link = &(*link)->next;
+        }
+        unlink(link);
+        return next;
+    }
+    iterator erase(iterator pos) { return erase(const_iterator(pos)); }
+
+private:
+    static value_type *entry(const HTNode *node) noexcept {
+        return std::launder(reinterpret_cast<value_type *>(const_cast<max_align_t *>(node->data)));
+    }
+
+    // Entries go in node data, where the engine sized room for a key of
+    // sizeof(K) followed by a value of sizeof(V) aligned at least as strictly
+    // as V, which is never less than a std::pair<const K, V> takes
+    void init() {
+        if (ht_.arr) {
+            return;
+        }
+        HTConfig config = {};
+        config.backend = HT_CHAINED;
+        config.cap_policy = HT_CAP_POW2;
+        if (!ht_init_with(&ht_, sizeof(K), sizeof(V), &config)) {
+            ht_ = Hashtable{};
+            throw std::bad_alloc();
+        }
+    }
+
+    // frees the buckets and slab, leaving an empty map
+    void release() noexcept {
+        if (!ht_.arr) {
+            return;
+        }
+        destroy_entries();
+        ht_deinit(&ht_);
+        ht_ = Hashtable{};
+    }
+
+    void destroy_entries() noexcept {
+        if constexpr (!std::is_trivially_destructible_v<value_type>) {
+            // ++ only reads the node header, past the destroyed entry
+            for (const_iterator it = begin(); it != end(); ++it) {
+                it->~value_type();
+            }
+        }
+    }
+
+    // grows the buckets before a new entry would pass the 0.75 load factor,
+    // freeing node when that fails
+    void grow(HTNode *node) {
+        if ((float)ht_.count / ht_.arr_cap >= 0.75 && !ht_resize(&ht_, 2 * ht_.arr_cap)) {
+            entry(node)->~value_type();
+            ht_slab_free(&ht_.slab, node);
+            throw std::bad_alloc();
+        }
+    }
+
+    template <class KeyArg, class... Args>
+    std::pair<iterator, bool> emplace_key(KeyArg &&key, Args &&...args) {
+        init();
+        uint64_t key_hash = hash_(key);
+        if (HTNode **link = find_link(key, key_hash)) {
+            return {at_node(*link), false};
+        }
+        HTNode *node = construct(std::piecewise_construct, std::forward_as_tuple(std::forward<KeyArg>(key)),
+                                 std::forward_as_tuple(std::forward<Args>(args)...));
+        grow(node);
+        ht_link_node(&ht_, node, key_hash);
+        return {at_node(node), true};
+    }
+
+    // a slab node holding an entry built from args, not yet linked
+    template <class... Args>
+    HTNode *construct(Args &&...args) {
+        HTNode *node = ht_slab_alloc(&ht_.slab);
+        if (!node) {
+            throw std::bad_alloc();
+        }
+        try {
+            new (node->data) value_type(std::forward<Args>(args)...);
+        } catch (...) {
+            ht_slab_free(&ht_.slab, node);
+            throw;
+        }
+        return node;
+    }
+
+    // copies value into a new node linked under key_hash, the key is known to be absent
+    void link(uint64_t key_hash, const value_type &value) {
+        HTNode *node = construct(value);
+        grow(node);
+        ht_link_node(&ht_, node, key_hash);
+    }
+
+    void unlink(HTNode **link) noexcept {
+        HTNode *node = *link;
+        *link = node->next;
+        entry(node)->~value_type();
+        ht_slab_free(&ht_.slab, node);
+        ht_.count--;
+    }
+
+    // link pointing at the node holding key, or nullptr
+    template <class Q>
+    HTNode **find_link(const Q &key, uint64_t key_hash) const {
+        HT_COUNT(&ht_, lookups, 1);
+        HTNode **link = &ht_.arr[bucket_index(&ht_, key_hash, ht_.arr_cap)];
+        for (; *link; link = &(*link)->next) {
+            HT_COUNT(&ht_, probes, 1);
+            if ((*link)->stored_hash == key_hash && eq_(entry(*link)->first, key)) {
+                return link;
+            }
+        }
+        return nullptr;
+    }
+
+    template <class Q>
+    HTNode *lookup(const Q &key) const {
+        if (ht_.count == 0) {
+            return nullptr;
+        }
+        HTNode **link = find_link(key, hash_(key));
+        return link ? *link : nullptr;
+    }
+
+    template <class It, class Q>
+    It find_iter(const Q &key) const {
+        HTNode *node = lookup(key);
+        return node ? It(&ht_, bucket_index(&ht_, node->stored_hash, ht_.arr_cap), node) : It();
+    }
+
+    iterator at_node(HTNode *node) noexcept {
+        return iterator(&ht_, bucket_index(&ht_, node->stored_hash, ht_.arr_cap), node);
+    }
+
+    template <class It>
+    It first() const noexcept {
+        for (size_t b = 0; ht_.count > 0 && b < ht_.arr_cap; b++) {
+            if (ht_.arr[b]) {
+                return It(&ht_, b, ht_.arr[b]);
+            }
+        }
+        return It();
+    }
+
+    static V &checked(HTNode *node) {
+        if (!node) {
+            throw std::out_of_range("ht::map::at: key not found");
+        }
+        return entry(node)->second;
+    }
+
+    Hashtable ht_ = {}; // zeroed, with arr == nullptr, until the first insert or reserve
+    Hash hash_ = Hash();
+    Eq eq_ = Eq();
+};
+
+template <class K, class V, class Hash, class Eq>
+void swap(map<K, V, Hash, Eq> &a, map<K, V, Hash, Eq> &b) noexcept {
+    a.swap(b);
+}
+
+} // namespace ht
+
+#endif // HT_MAP_HPP
@@ -0,0 +1,204 @@
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <string_view>
+#include "ht_map.hpp"
+
+// operator new calls, for checking which operations allocate
+static size_t allocations = 0;
+
+void *operator new(size_t size) {
+    allocations++;
+    void *p = malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    free(p);
+}
+
+// counts live instances and how many were ever constructed
+struct Tracked {
+    static int live;
+    static int constructed;
+    int value;
+    explicit Tracked(int v) : value(v) {
+        live++;
+        constructed++;
+    }
+    Tracked(const Tracked &other) : Tracked(other.value) {}
+    ~Tracked() { live--; }
+};
+int Tracked::live = 0;
+int Tracked::constructed = 0;
+
+// neither copyable nor movable, only constructible in place
+struct Pinned {
+    int a, b;
+    Pinned(int a, int b) : a(a), b(b) {}
+    Pinned(const Pinned &) = delete;
+    Pinned &operator=(const Pinned &) = delete;
+};
+
+void test_map_basic() {
+    printf("Running map basic test...\n");
+    ht::map<int, long> m;
+    assert(m.empty() && m.begin() == m.end() && !m.contains(3) && m.erase(3) == 0);
+    for (int i = 0; i < 10000; i++) {
+        assert(m.try_emplace(i, (long)i * 2).second);
+    }
+    assert(m.size() == 10000);
+    assert(!m.try_emplace(5, 0L).second && m.at(5) == 10);
+    assert(!m.insert_or_assign(5, 50L).second && m.at(5) == 50);
+    assert(m.insert({20000, 1L}).second && m.size() == 10001);
+    m[20001] += 7;
+    assert(m[20001] == 7 && m.size() == 10002);
+    assert(m.find(123)->second == 246 && m.find(-1) == m.end());
+    assert(m.count(9999) == 1 && m.count(10000) == 0);
+
+    bool threw = false;
+    try {
+        m.at(-1);
+    } catch (const std::out_of_range &) {
+        threw = true;
+    }
+    assert(threw);
+
+    for (int i = 0; i < 10000; i += 2) {
+        assert(m.erase(i) == 1);
+    }
+    assert(m.size() == 5002 && !m.contains(0) && m.contains(1));
+    m.clear();
+    assert(m.empty() && !m.contains(1));
+    m[1] = 1;
+    assert(m.size() == 1);
+    printf("Passed: map basic test\n");
+}
+
+void test_map_iterators() {
+    printf("Running map iterator test...\n");
+    ht::map<int, int> m;
+    for (int i = 0; i < 1000; i++) {
+        m[i] = i;
+    }
+    long sum = 0;
+    for (auto &[key, value] : m) {
+        assert(key == value);
+        value++;
+        sum += key;
+    }
+    assert(sum == 999 * 1000 / 2);
+    assert(std::distance(m.begin(), m.end()) == 1000);
+    const ht::map<int, int> &cm = m;
+    for (ht::map<int, int>::const_iterator it = cm.begin(); it != cm.end(); ++it) {
+        assert(it->second == it->first + 1);
+    }
+
+    // erase returns the next entry, removing the odd keys while walking
+    for (auto it = m.begin(); it != m.end();) {
+        it = it->first % 2 ? m.erase(it) : std::next(it);
+    }
+    assert(m.size() == 500);
+    for (const auto &entry : m) {
+        assert(entry.first % 2 == 0);
+    }
+    printf("Passed: map iterator test\n");
+}
+
+void test_map_string_keys() {
+    printf("Running map string key test...\n");
+    ht::map<std::string, int> m;
+    std::string long_key(64, 'k');
+    m.try_emplace(long_key, 1);
+    m.try_emplace("short", 2);
+    m.emplace(std::string(40, 'e'), 3);
+    assert(m.size() == 3);
+
+    size_t before = allocations;
+    std::string_view view(long_key);
+    assert(m.find(view)->second == 1);
+    assert(m.contains(std::string_view("short")) && m.at("short") == 2);
+    assert(m.count(std::string_view(long_key.data(), 63)) == 0);
+    assert(!m.contains("missing, and much longer than any small string buffer"));
+    assert(allocations == before);
+
+    // entries do not move while the table grows
+    const int *value = &m.at(long_key);
+    for (int i = 0; i < 5000; i++) {
+        m[std::to_string(i)] = i;
+    }
+    assert(value == &m.at(view) && *value == 1);
+    assert(m.at("4999") == 4999 && m.size() == 5003);
+    printf("Passed: map string key test\n");
+}
+
+void test_map_in_place() {
+    printf("Running map in place construction test...\n");
+    {
+        ht::map<int, std::unique_ptr<int>> m;
+        assert(m.try_emplace(1, std::make_unique<int>(10)).second);
+        auto ptr = std::make_unique<int>(20);
+        assert(!m.try_emplace(1, std::move(ptr)).second && ptr && *m.at(1) == 10);
+        m.insert_or_assign(1, std::move(ptr));
+        assert(!ptr && *m.at(1) == 20);
+        std::pair<const int, std::unique_ptr<int>> entry(1000, std::make_unique<int>(1000));
+        assert(m.insert(std::move(entry)).second && !entry.second && *m.at(1000) == 1000);
+        for (int i = 2; i < 1000; i++) {
+            m.emplace(i, std::make_unique<int>(i));
+        }
+        ht::map<int, std::unique_ptr<int>> moved(std::move(m));
+        assert(m.empty() && moved.size() == 1000 && *moved.at(999) == 999);
+        m = std::move(moved);
+        assert(m.size() == 1000 && moved.empty());
+        m[0] = std::make_unique<int>(0);
+        assert(m.size() == 1001);
+    }
+
+    ht::map<int, Pinned> pinned;
+    assert(pinned.try_emplace(7, 1, 2).second);
+    assert(pinned.at(7).a == 1 && pinned.at(7).b == 2);
+    pinned.emplace(std::piecewise_construct, std::forward_as_tuple(8), std::forward_as_tuple(3, 4));
+    assert(pinned.at(8).b == 4);
+
+    {
+        ht::map<int, Tracked> m;
+        for (int i = 0; i < 100; i++) {
+            m.try_emplace(i, i);
+        }
+        // try_emplace on a present key constructs nothing
+        int constructed = Tracked::constructed;
+        assert(!m.try_emplace(5, 500).second && Tracked::constructed == constructed);
+        assert(Tracked::live == 100);
+        ht::map<int, Tracked> copy = m;
+        assert(Tracked::live == 200 && copy.at(42).value == 42);
+        m.erase(3);
+        m.erase(m.find(4));
+        assert(Tracked::live == 198);
+        copy.clear();
+        assert(Tracked::live == 98);
+        copy = m;
+        assert(Tracked::live == 196 && copy.size() == 98);
+    }
+    assert(Tracked::live == 0);
+    printf("Passed: map in place construction test\n");
+}
+
+int main() {
+    printf("Starting map tests...\n");
+    test_map_basic();
+    test_map_iterators();
+    test_map_string_keys();
+    test_map_in_place();
+    printf("All map tests passed successfully!\n");
+    return 0;
+}
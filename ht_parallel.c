@@ -0,0 +1,108 @@
+#include "ht_internal.h"
+#include <assert.h>
+#include <pthread.h>
+#include <unistd.h>
+
+// Parallel scans start their workers on every call, the scans they are meant
+// for take far longer than creating a thread. Worker 0 runs on the calling
+// thread, and a slice whose thread can't be created runs there too.
+
+#define MAX_SCAN_THREADS 256
+
+typedef struct ScanWorker {
+    const Hashtable *ht;
+    size_t lo, hi;
+    HTForeachFunc fn;
+    void *ctx;
+    // ht_parallel_reduce
+    HTReduceFunc reduce;
+    void *acc;
+    void *reduce_ctx;
+} ScanWorker;
+
+static void reduce_entry(void *key, void *value, void *ctx) {
+    ScanWorker *worker = ctx;
+    worker->reduce(key, value, worker->acc, worker->reduce_ctx);
+}
+
+static void *scan_worker(void *p) {
+    ScanWorker *worker = p;
+    ht_foreach_range(worker->ht, worker->lo, worker->hi, worker->fn, worker->ctx);
+    return NULL;
+}
+
+static size_t scan_threads(const Hashtable *ht, size_t threads) {
+    if (threads == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (size_t)cpus : 1;
+    }
+    if (threads > MAX_SCAN_THREADS) {
+        threads = MAX_SCAN_THREADS;
+    }
+    if (threads > ht->arr_cap) {
+        threads = ht->arr_cap > 0 ? ht->arr_cap : 1;
+    }
+    return threads;
+}
+
+// gives every worker its slice and runs them, fn and ctx are already set
+static void run_workers(const Hashtable *ht, ScanWorker *workers, size_t threads) {
+    pthread_t ids[MAX_SCAN_THREADS];
+    bool started[MAX_SCAN_THREADS];
+    for (size_t t = 0; t < threads; t++) {
+        workers[t].ht = ht;
+        workers[t].lo = ht->arr_cap * t / threads;
+        workers[t].hi = ht->arr_cap * (t + 1) / threads;
+    }
+    for (size_t t = 1; t < threads; t++) {
+        started[t] = pthread_create(&ids[t], NULL, scan_worker, &workers[t]) == 0;
+    }
+    scan_worker(&workers[0]);
+    for (size_t t = 1; t < threads; t++) {
+        if (started[t]) {
+            pthread_join(ids[t], NULL);
+        } else {
+            scan_worker(&workers[t]);
+        }
+    }
+}
+
+void ht_parallel_foreach(const Hashtable *ht, HTForeachFunc fn, void *ctx, size_t threads) {
+    assert(ht); assert(fn);
+    ht_scan_prepare(ht);
+    threads = scan_threads(ht, threads);
+    ScanWorker workers[MAX_SCAN_THREADS];
+    for (size_t t = 0; t < threads; t++) {
+        workers[t] = (ScanWorker){ .fn = fn, .ctx = ctx };
+    }
+    run_workers(ht, workers, threads);
+}
+
+// accumulators get cache lines of their own so workers never share one
+bool ht_parallel_reduce(const Hashtable *ht, size_t threads, const void *init, size_t acc_size,
+                        HTReduceFunc reduce, HTCombineFunc combine, void *ctx, void *out_acc) {
+    assert(ht); assert(init); assert(reduce); assert(combine); assert(out_acc);
+    ht_scan_prepare(ht);
+    threads = scan_threads(ht, threads);
+    size_t stride = (acc_size + 63) & ~(size_t)63;
+    unsigned char *accs = aligned_alloc(64, threads * (stride ? stride : 64));
+    if (!accs) {
+        fprintf(stderr, "Failed to allocate accumulators in ht_parallel_reduce\n");
+        return false;
+    }
+    ScanWorker workers[MAX_SCAN_THREADS];
+    for (size_t t = 0; t < threads; t++) {
+        void *acc = accs + t * stride;
+        memcpy(acc, init, acc_size);
+        workers[t] = (ScanWorker){ .fn = reduce_entry, .reduce = reduce, .acc = acc, .reduce_ctx = ctx };
+        workers[t].ctx = &workers[t];
+    }
+    run_workers(ht, workers, threads);
+
+    memcpy(out_acc, init, acc_size);
+    for (size_t t = 0; t < threads; t++) {
+        combine(out_acc, workers[t].acc, ctx);
+    }
+    free(accs);
+    return true;
+}
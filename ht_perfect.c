@@ -0,0 +1,346 @@
+#include "ht_perfect.h"
+#include "ht_internal.h"
+#include <assert.h>
+
+// PTHash: Giulio Ermanno Pibiri and Roberto Trani, SIGIR 2021. Keys are placed
+// by the hash their table cached, so building never calls the hash function.
+// Buckets are searched largest first, while most positions are still free.
+// A bucket whose pilot search runs past HT_PERFECT_MAX_PILOT restarts the
+// build with the next seed.
+
+#define HT_PERFECT_MAX_PILOT (1u << 20)
+#define HT_PERFECT_SEEDS 8
+#define HT_PERFECT_DENSE_KEYS 0x9999999Aull // 60% of the low 32 hash bits go to dense buckets
+
+typedef struct PerfectKey {
+    uint64_t hash;
+    const void *key;
+    const void *value;
+} PerfectKey;
+
+typedef struct PerfectBuild {
+    PerfectKey *keys;
+    size_t used;
+} PerfectBuild;
+
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ull;
+    x ^= x >> 33;
+    return x;
+}
+
+// 60% of the keys share the first 30% of the buckets, so the large buckets
+// searched first are many and the late ones, placed among few free positions,
+// are mostly small
+static size_t perfect_bucket(const HTPerfect *ph, uint64_t key_hash) {
+    uint64_t hi = key_hash >> 32;
+    if ((key_hash & 0xffffffffull) < HT_PERFECT_DENSE_KEYS && ph->dense_buckets > 0) {
+        return (size_t)((hi * ph->dense_buckets) >> 32);
+    }
+    return ph->dense_buckets + (size_t)((hi * (ph->bucket_count - ph->dense_buckets)) >> 32);
+}
+
+static size_t perfect_position(const HTPerfect *ph, uint64_t key_hash, uint64_t pilot) {
+    uint64_t x = mix64(key_hash ^ ph->seed ^ (pilot * 0x9E3779B97F4A7C15ull));
+    return (size_t)(((unsigned __int128)x * ph->slot_count) >> 64);
+}
+
+static uint64_t read_pilot(const HTPerfect *ph, size_t bucket) {
+    size_t bit = bucket * ph->pilot_bits;
+    uint64_t v = ph->pilots[bit / 64] >> (bit % 64);
+    if (bit % 64 + ph->pilot_bits > 64) {
+        v |= ph->pilots[bit / 64 + 1] << (64 - bit % 64);
+    }
+    return v & ((1ull << ph->pilot_bits) - 1);
+}
+
+static void collect_key(uint64_t key_hash, const void *key, const void *value, void *ctx) {
+    PerfectBuild *b = ctx;
+    b->keys[b->used++] = (PerfectKey){ key_hash, key, value };
+}
+
+#define bit_test(bits, i) ((bits)[(i) / 64] >> ((i) % 64) & 1)
+#define bit_set(bits, i) ((bits)[(i) / 64] |= 1ull << ((i) % 64))
+
+// Finds a pilot for every bucket with the current seed. members lists the keys
+// grouped by bucket from bucket_first, order the buckets largest first.
+static bool search_pilots(HTPerfect *ph, const PerfectKey *keys, const uint32_t *members, const uint32_t *bucket_first,
+                          const uint32_t *order, uint32_t *pilots, uint64_t *taken, size_t *positions) {
+    memset(taken, 0, (ph->slot_count + 63) / 64 * sizeof(uint64_t));
+    for (size_t o = 0; o < ph->bucket_count; o++) {
+        uint32_t bucket = order[o];
+        const uint32_t *first = members + bucket_first[bucket];
+        size_t k = bucket_first[bucket + 1] - bucket_first[bucket];
+        if (k == 0) {
+            break;
+        }
+        uint32_t pilot = 0;
+        for (; pilot < HT_PERFECT_MAX_PILOT; pilot++) {
+            size_t j = 0;
+            for (; j < k; j++) {
+                size_t pos = perfect_position(ph, keys[first[j]].hash, pilot);
+                if (bit_test(taken, pos)) {
+                    break;
+                }
+                size_t l = 0;
+                while (l < j && positions[l] != pos) {
+                    l++;
+                }
+                if (l < j) {
+                    break;
+                }
+                positions[j] = pos;
+            }
+            if (j == k) {
+                break;
+            }
+        }
+        if (pilot == HT_PERFECT_MAX_PILOT) {
+            return false;
+        }
+        for (size_t j = 0; j < k; j++) {
+            bit_set(taken, positions[j]);
+        }
+        pilots[bucket] = pilot;
+    }
+    return true;
+}
+
+// groups keys by bucket and orders buckets by size, fails if two keys of a
+// bucket share their hash since no pilot can separate them
+static bool group_buckets(const HTPerfect *ph, const PerfectKey *keys, uint32_t *members, uint32_t *bucket_first,
+                          uint32_t *order, size_t *max_size) {
+    size_t nb = ph->bucket_count;
+    memset(bucket_first, 0, (nb + 1) * sizeof(uint32_t));
+    for (size_t i = 0; i < ph->count; i++) {
+        bucket_first[perfect_bucket(ph, keys[i].hash) + 1]++;
+    }
+    *max_size = 0;
+    for (size_t b = 0; b < nb; b++) {
+        *max_size = bucket_first[b + 1] > *max_size ? bucket_first[b + 1] : *max_size;
+        bucket_first[b + 1] += bucket_first[b];
+    }
+    // placing advances every start to the start of the next bucket
+    for (size_t i = 0; i < ph->count; i++) {
+        members[bucket_first[perfect_bucket(ph, keys[i].hash)]++] = (uint32_t)i;
+    }
+    memmove(bucket_first + 1, bucket_first, nb * sizeof(uint32_t));
+    bucket_first[0] = 0;
+
+    for (size_t b = 0; b < nb; b++) {
+        for (uint32_t i = bucket_first[b]; i < bucket_first[b + 1]; i++) {
+            for (uint32_t j = bucket_first[b]; j < i; j++) {
+                if (keys[members[i]].hash == keys[members[j]].hash) {
+                    fprintf(stderr, "Two keys share a 64 bit hash in ht_perfect_init\n");
+                    return false;
+                }
+            }
+        }
+    }
+
+    // counting sort of the buckets by size, largest first
+    size_t *by_size = (size_t *)calloc(*max_size + 2, sizeof(size_t));
+    if (!by_size) {
+        return false;
+    }
+    for (size_t b = 0; b < nb; b++) {
+        by_size[*max_size - (bucket_first[b + 1] - bucket_first[b]) + 1]++;
+    }
+    for (size_t s = 0; s <= *max_size; s++) {
+        by_size[s + 1] += by_size[s];
+    }
+    for (size_t b = 0; b < nb; b++) {
+        order[by_size[*max_size - (bucket_first[b + 1] - bucket_first[b])]++] = (uint32_t)b;
+    }
+    free(by_size);
+    return true;
+}
+
+// pilots packed at the width of the largest, and the remap of positions past count
+static bool encode(HTPerfect *ph, const uint32_t *pilots, const uint64_t *taken) {
+    uint32_t max_pilot = 0;
+    for (size_t b = 0; b < ph->bucket_count; b++) {
+        max_pilot = pilots[b] > max_pilot ? pilots[b] : max_pilot;
+    }
+    ph->pilot_bits = max_pilot > 0 ? 32 - __builtin_clz(max_pilot) : 1;
+    size_t words = (ph->bucket_count * ph->pilot_bits + 63) / 64 + 1;
+    ph->pilots = (uint64_t *)calloc(words, sizeof(uint64_t));
+    ph->remap = (uint32_t *)malloc((ph->slot_count - ph->count) * sizeof(uint32_t));
+    if (!ph->pilots || !ph->remap) {
+        return false;
+    }
+    for (size_t b = 0; b < ph->bucket_count; b++) {
+        size_t bit = b * ph->pilot_bits;
+        ph->pilots[bit / 64] |= (uint64_t)pilots[b] << (bit % 64);
+        if (bit % 64 + ph->pilot_bits > 64) {
+            ph->pilots[bit / 64 + 1] |= (uint64_t)pilots[b] >> (64 - bit % 64);
+        }
+    }
+    // as many positions past count are taken as there are holes below it
+    size_t hole = 0;
+    for (size_t pos = ph->count; pos < ph->slot_count; pos++) {
+        if (bit_test(taken, pos)) {
+            while (bit_test(taken, hole)) {
+                hole++;
+            }
+            ph->remap[pos - ph->count] = (uint32_t)hole++;
+        }
+    }
+    return true;
+}
+
+bool ht_perfect_init(HTPerfect *ph, const Hashtable *ht) {
+    if (!ph || !ht) {
+        fprintf(stderr, "Valid table pointers are required for ht_perfect_init\n");
+        return false;
+    }
+    memset(ph, 0, sizeof(HTPerfect));
+    if (ht->key_size == HT_VARLEN_KEY) {
+        fprintf(stderr, "ht_perfect_init needs a fixed key_size\n");
+        return false;
+    }
+    if (ht->count > UINT32_MAX) {
+        fprintf(stderr, "ht_perfect_init supports at most %u entries\n", UINT32_MAX);
+        return false;
+    }
+    ph->count = ht->count;
+    ph->slot_count = ht->count + ht->count / 99 + 1;
+    ph->bucket_count = (ht->count + HT_PERFECT_LAMBDA - 1) / HT_PERFECT_LAMBDA + 1;
+    ph->dense_buckets = ph->bucket_count * 3 / 10;
+    ph->key_size = ht->key_size;
+    ph->value_size = ht->value_size;
+    ph->value_offset = ht->value_offset;
+    ph->entry_size = ht->entry_size;
+    ph->hash_kind = ht->hash_kind;
+    ph->hash_fn = ht->hash_fn;
+
+    PerfectBuild build = { .keys = (PerfectKey *)malloc(ph->count * sizeof(PerfectKey) + 1) };
+    uint32_t *members = (uint32_t *)malloc(ph->count * sizeof(uint32_t) + 1);
+    uint32_t *bucket_first = (uint32_t *)malloc((ph->bucket_count + 1) * sizeof(uint32_t));
+    uint32_t *order = (uint32_t *)malloc(ph->bucket_count * sizeof(uint32_t));
+    uint32_t *pilots = (uint32_t *)calloc(ph->bucket_count, sizeof(uint32_t));
+    uint64_t *taken = (uint64_t *)malloc((ph->slot_count + 63) / 64 * sizeof(uint64_t));
+    size_t *positions = NULL;
+    size_t max_size = 0;
+    bool ok = build.keys && members && bucket_first && order && pilots && taken;
+    if (ok) {
+        ht_foreach_hashed(ht, collect_key, &build);
+        ok = group_buckets(ph, build.keys, members, bucket_first, order, &max_size);
+    }
+    if (ok) {
+        positions = (size_t *)malloc((max_size + 1) * sizeof(size_t));
+        ok = positions != NULL;
+    }
+    bool found = false;
+    for (uint64_t attempt = 0; ok && !found && attempt < HT_PERFECT_SEEDS; attempt++) {
+        ph->seed = mix64(attempt + 1);
+        memset(pilots, 0, ph->bucket_count * sizeof(uint32_t));
+        found = search_pilots(ph, build.keys, members, bucket_first, order, pilots, taken, positions);
+    }
+    ok = ok && found && encode(ph, pilots, taken);
+    if (ok) {
+        ph->slots = (unsigned char *)calloc(ph->count + 1, ph->entry_size);
+        ok = ph->slots != NULL;
+    }
+    for (size_t i = 0; ok && i < ph->count; i++) {
+        const PerfectKey *k = &build.keys[i];
+        size_t pos = perfect_position(ph, k->hash, read_pilot(ph, perfect_bucket(ph, k->hash)));
+        if (pos >= ph->count) {
+            pos = ph->remap[pos - ph->count];
+        }
+        unsigned char *slot = ph->slots + pos * ph->entry_size;
+        memcpy(slot, k->key, ph->key_size);
+        memcpy(slot + ph->value_offset, k->value, ph->value_size);
+    }
+    free(build.keys);
+    free(members);
+    free(bucket_first);
+    free(order);
+    free(pilots);
+    free(taken);
+    free(positions);
+    if (!ok) {
+        fprintf(stderr, "Failed to build a perfect hash in ht_perfect_init\n");
+        ht_perfect_deinit(ph);
+    }
+    return ok;
+}
+
+HTPerfect *ht_perfect_create(const Hashtable *ht) {
+    HTPerfect *ph = (HTPerfect *)malloc(sizeof(HTPerfect));
+    if (!ph) {
+        fprintf(stderr, "Failed to allocate table during ht_perfect_create\n");
+        return NULL;
+    }
+    if (!ht_perfect_init(ph, ht)) {
+        fprintf(stderr, "Failed to call ht_perfect_init during ht_perfect_create\n");
+        free(ph);
+        return NULL;
+    }
+    return ph;
+}
+
+void ht_perfect_deinit(HTPerfect *ph) {
+    free(ph->pilots);
+    free(ph->remap);
+    free(ph->slots);
+    ph->pilots = NULL;
+    ph->remap = NULL;
+    ph->slots = NULL;
+    ph->count = 0;
+}
+
+void _ht_perfect_destroy(HTPerfect **ph_ptr) {
+    if (ph_ptr && *(ph_ptr)) {
+        ht_perfect_deinit(*ph_ptr);
+        free(*ph_ptr);
+        *ph_ptr = NULL;
+    }
+}
+
+// keys that were not in the table land on some entry too, the key compare
+// tells them apart
+const void *ht_perfect_find(const HTPerfect *ph, const void *key) {
+    assert(ph); assert(key);
+    if (ph->count == 0) {
+        return NULL;
+    }
+    uint64_t key_hash = ph->hash_fn(key, ph->key_size);
+    size_t pos = perfect_position(ph, key_hash, read_pilot(ph, perfect_bucket(ph, key_hash)));
+    if (pos >= ph->count) {
+        pos = ph->remap[pos - ph->count];
+    }
+    const unsigned char *slot = ph->slots + pos * ph->entry_size;
+    return memcmp(slot, key, ph->key_size) == 0 ? slot + ph->value_offset : NULL;
+}
+
+bool ht_perfect_get(const HTPerfect *ph, const void *key, void *out_value) {
+    assert(out_value);
+    const void *value = ht_perfect_find(ph, key);
+    if (!value) {
+        return false;
+    }
+    memcpy(out_value, value, ph->value_size);
+    return true;
+}
+
+bool ht_perfect_contains(const HTPerfect *ph, const void *key) {
+    return ht_perfect_find(ph, key) != NULL;
+}
+
+size_t ht_perfect_count(const HTPerfect *ph) {
+    assert(ph);
+    return ph->count;
+}
+
+double ht_perfect_bits_per_key(const HTPerfect *ph) {
+    assert(ph);
+    if (ph->count == 0) {
+        return 0;
+    }
+    size_t words = (ph->bucket_count * ph->pilot_bits + 63) / 64 + 1;
+    return (double)(words * 64 + (ph->slot_count - ph->count) * 32) / ph->count;
+}
@@ -0,0 +1,47 @@
+#ifndef HT_PERFECT_H
+#define HT_PERFECT_H
+
+#include "hashtable.h"
+
+// Read only table indexed by a minimal perfect hash of the keys of a finished
+// Hashtable, built PTHash style. Keys are split into buckets of about
+// HT_PERFECT_LAMBDA keys, and every bucket gets the smallest pilot that sends
+// all of its keys to free positions among slot_count, slightly more than count.
+// The few positions past count are mapped back onto the holes below it. A lookup
+// reads one pilot and compares the key of exactly one entry.
+typedef struct HTPerfect {
+    size_t count;
+    size_t slot_count; // positions pilots map to, about count / 0.99
+    size_t bucket_count;
+    size_t dense_buckets; // the first buckets, which take 60% of the keys
+    uint64_t seed;
+    unsigned int pilot_bits;
+    uint64_t *pilots; // pilot_bits per bucket, packed
+    uint32_t *remap; // entry of each position in [count, slot_count) used by a key
+    unsigned char *slots; // count entries laid out like Hashtable slots, entry_size apart
+    size_t key_size;
+    size_t value_size;
+    size_t value_offset;
+    size_t entry_size;
+    HTHashKind hash_kind;
+    HTHashFunc hash_fn;
+} HTPerfect;
+
+#define HT_PERFECT_LAMBDA 5
+
+// copies the entries of ht, any backend, which is not modified. Fails for more
+// than UINT32_MAX entries or when two keys have the same 64 bit hash.
+bool ht_perfect_init(HTPerfect *ph, const Hashtable *ht);
+HTPerfect *ht_perfect_create(const Hashtable *ht);
+void ht_perfect_deinit(HTPerfect *ph);
+void _ht_perfect_destroy(HTPerfect **ph);
+#define ht_perfect_destroy(ph) _ht_perfect_destroy(&ph);
+
+const void *ht_perfect_find(const HTPerfect *ph, const void *key);
+bool ht_perfect_get(const HTPerfect *ph, const void *key, void *out_value);
+bool ht_perfect_contains(const HTPerfect *ph, const void *key);
+size_t ht_perfect_count(const HTPerfect *ph);
+// size of the pilots and the remap table per key, the entries not included
+double ht_perfect_bits_per_key(const HTPerfect *ph);
+
+#endif // HT_PERFECT_H
@@ -0,0 +1,297 @@
+#include "ht_internal.h"
+#include <assert.h>
+
+// Open addressing backend using Robin Hood linear probing. ctrl holds the probe
+// distance of each slot plus one, 0 marks an empty slot. Entries are kept
+// ordered so that a richer entry (closer to its home slot) never precedes a
+// poorer one, which bounds probe lengths and lets a lookup stop as soon as it
+// sees a slot closer to home than the key would be. Deletion shifts the rest of
+// the run back by one slot instead of leaving a tombstone, so lookups stay as
+// fast after heavy churn as in a freshly built table.
+
+#define MIN_CAP 16
+#define MAX_DIST 255
+#define MAX_SPARSITY 8 // slots per entry, see growth_limit
+
+#define home_slot(ht, hash) ((hash) & ((ht)->arr_cap - 1))
+#define next_slot(ht, idx) (((idx) + 1) & ((ht)->arr_cap - 1))
+#define prev_slot(ht, idx) (((idx) - 1) & ((ht)->arr_cap - 1))
+
+static size_t max_load(size_t cap) {
+    return cap - cap / 8;
+}
+
+static size_t next_pow2(size_t x) {
+    size_t cap = MIN_CAP;
+    while (cap < x) {
+        cap <<= 1;
+    }
+    return cap;
+}
+
+// capacity past which doubling no longer shortens probe runs. Only keys sharing
+// most of their hash bits still overflow MAX_DIST in a table this sparse, such as
+// more than MAX_DIST - 1 keys with one hash, so puts fail there instead of
+// doubling until allocation fails.
+static size_t growth_limit(size_t count) {
+    return MAX_SPARSITY * next_pow2(count + 1);
+}
+
+static bool alloc_arrays(Hashtable *ht, size_t cap) {
+    if (cap > SIZE_MAX / ht->entry_size || cap > SIZE_MAX / sizeof(uint64_t)) {
+        return false;
+    }
+    uint8_t *ctrl = (uint8_t *)calloc(cap, 1);
+    unsigned char *slots = (unsigned char *)malloc(cap * ht->entry_size);
+    uint64_t *hashes = (uint64_t *)malloc(cap * sizeof(uint64_t));
+    if (!ctrl || !slots || !hashes) {
+        free(ctrl);
+        free(slots);
+        free(hashes);
+        return false;
+    }
+    ht->ctrl = ctrl;
+    ht->slots = slots;
+    ht->hashes = hashes;
+    ht->arr_cap = cap;
+    return true;
+}
+
+bool ht_robin_hood_init(Hashtable *ht, size_t min_cap) {
+    if (!alloc_arrays(ht, next_pow2(min_cap))) {
+        fprintf(stderr, "Failed to allocate slot arrays during ht_init\n");
+        return false;
+    }
+    return true;
+}
+
+// finds the slot holding key. On a miss *out_idx is the insert_index of
+// key_hash, where the lookup stopped.
+static bool find_index(const Hashtable *ht, const void *key, uint64_t key_hash, size_t *out_idx) {
+    size_t idx = home_slot(ht, key_hash);
+    HT_COUNT(ht, lookups, 1);
+    for (size_t dist = 1; ht->ctrl[idx] >= dist; dist++) {
+        HT_COUNT(ht, probes, 1);
+        if (ht->hashes[idx] == key_hash && memcmp(key, ht_slot_at(ht, idx), ht->key_size) == 0) {
+            *out_idx = idx;
+            return true;
+        }
+        idx = next_slot(ht, idx);
+    }
+    *out_idx = idx;
+    return false;
+}
+
+// slot a new entry for key_hash takes, the first one whose occupant is richer
+// than the entry would be
+static size_t insert_index(const Hashtable *ht, uint64_t key_hash) {
+    size_t idx = home_slot(ht, key_hash);
+    for (size_t dist = 1; ht->ctrl[idx] >= dist; dist++) {
+        idx = next_slot(ht, idx);
+    }
+    return idx;
+}
+
+static void move_slot(Hashtable *ht, size_t to, size_t from, uint8_t new_dist) {
+    ht->ctrl[to] = new_dist;
+    ht->hashes[to] = ht->hashes[from];
+    memcpy(ht_slot_at(ht, to), ht_slot_at(ht, from), ht->entry_size);
+}
+
+// makes idx, the insert_index of key_hash, the slot of an entry known to be
+// absent. The run up to the next empty slot moves one slot forward. Returns the
+// slot with its key and value left to the caller, or NULL without changing
+// anything if a probe distance would overflow the control byte, the caller then
+// grows the table.
+static unsigned char *shift_in(Hashtable *ht, size_t idx, uint64_t key_hash) {
+    size_t dist = ((idx - home_slot(ht, key_hash)) & (ht->arr_cap - 1)) + 1;
+    if (dist >= MAX_DIST) {
+        return NULL;
+    }
+
+    size_t empty = idx;
+    while (ht->ctrl[empty] != 0) {
+        if (ht->ctrl[empty] >= MAX_DIST - 1) {
+            return NULL;
+        }
+        empty = next_slot(ht, empty);
+    }
+    for (size_t i = empty; i != idx; i = prev_slot(ht, i)) {
+        size_t from = prev_slot(ht, i);
+        move_slot(ht, i, from, ht->ctrl[from] + 1);
+    }
+
+    ht->ctrl[idx] = (uint8_t)dist;
+    ht->hashes[idx] = key_hash;
+    return ht_slot_at(ht, idx);
+}
+
+// inserts an entry known to be absent, false if the table has to grow first
+static bool place(Hashtable *ht, uint64_t key_hash, const void *key, const void *value) {
+    unsigned char *slot = shift_in(ht, insert_index(ht, key_hash), key_hash);
+    if (!slot) {
+        return false;
+    }
+    memcpy(slot, key, ht->key_size);
+    memcpy(ht_slot_value(ht, slot), value, ht->value_size);
+    return true;
+}
+
+static bool rehash(Hashtable *ht, size_t new_cap) {
+    Hashtable old = *ht;
+    while (true) {
+        if (!alloc_arrays(ht, new_cap)) {
+            *ht = old;
+            return false;
+        }
+        bool placed_all = true;
+        for (size_t i = 0; i < old.arr_cap && placed_all; i++) {
+            if (old.ctrl[i] != 0) {
+                unsigned char *slot = ht_slot_at(&old, i);
+                placed_all = place(ht, old.hashes[i], slot, ht_slot_value(&old, slot));
+            }
+        }
+        if (placed_all) {
+            break;
+        }
+        ht_robin_hood_deinit(ht);
+        if (new_cap >= growth_limit(old.count)) {
+            *ht = old;
+            return false;
+        }
+        new_cap *= 2;
+    }
+    ht->count = old.count;
+    free(old.ctrl);
+    free(old.slots);
+    free(old.hashes);
+    HT_COUNT(ht, resizes, 1);
+    return true;
+}
+
+bool ht_robin_hood_resize(Hashtable *ht, size_t new_cap) {
+    size_t min_cap = next_pow2(new_cap);
+    while (max_load(min_cap) <= ht->count) {
+        min_cap <<= 1;
+    }
+    if (!rehash(ht, min_cap)) {
+        fprintf(stderr, "ht_resize, failed to rebuild the slot arrays, old ht preserved\n");
+        return false;
+    }
+    return true;
+}
+
+// slot holding key, or a newly claimed one with the key copied in and the value
+// left to the caller. NULL when growing the table fails.
+static unsigned char *claim_slot(Hashtable *ht, const void *key, uint64_t key_hash, bool *found) {
+    size_t idx;
+    *found = find_index(ht, key, key_hash, &idx);
+    if (*found) {
+        return ht_slot_at(ht, idx);
+    }
+
+    bool grow = ht->count + 1 > max_load(ht->arr_cap);
+    unsigned char *slot = NULL;
+    while (grow || !(slot = shift_in(ht, idx, key_hash))) {
+        if (!grow && ht->arr_cap >= growth_limit(ht->count)) {
+            fprintf(stderr, "Probe run past the %d slot limit in ht_put, too many keys share a hash\n", MAX_DIST);
+            return NULL;
+        }
+        if (!rehash(ht, 2 * ht->arr_cap)) {
+            fprintf(stderr, "Failed to grow slot arrays in ht_put\n");
+            return NULL;
+        }
+        idx = insert_index(ht, key_hash);
+        grow = false;
+    }
+    memcpy(slot, key, ht->key_size);
+    ht->count++;
+    return slot;
+}
+
+bool ht_robin_hood_put(Hashtable *ht, const void *key, const void *value, uint64_t key_hash) {
+    bool found;
+    unsigned char *slot = claim_slot(ht, key, key_hash, &found);
+    if (!slot) {
+        return false;
+    }
+    memcpy(ht_slot_value(ht, slot), value, ht->value_size);
+    return true;
+}
+
+void *ht_robin_hood_get_or_insert(Hashtable *ht, const void *key, uint64_t key_hash, bool *inserted) {
+    bool found;
+    unsigned char *slot = claim_slot(ht, key, key_hash, &found);
+    if (!slot) {
+        return NULL;
+    }
+    *inserted = !found;
+    if (!found) {
+        memset(ht_slot_value(ht, slot), 0, ht->value_size);
+    }
+    return ht_slot_value(ht, slot);
+}
+
+void *ht_robin_hood_find(const Hashtable *ht, const void *key, uint64_t key_hash) {
+    size_t idx;
+    if (!find_index(ht, key, key_hash, &idx)) {
+        return NULL;
+    }
+    return ht_slot_value(ht, ht_slot_at(ht, idx));
+}
+
+// pulls in the home slot of key_hash ahead of a batched lookup
+void ht_robin_hood_prefetch(const Hashtable *ht, uint64_t key_hash) {
+    size_t idx = home_slot(ht, key_hash);
+    __builtin_prefetch(ht->ctrl + idx);
+    __builtin_prefetch(ht->hashes + idx);
+    __builtin_prefetch(ht_slot_at(ht, idx));
+}
+
+// backward shift deletion, every following entry that is not in its home slot
+// moves back by one until an empty slot or an entry already at home is reached
+bool ht_robin_hood_delete(Hashtable *ht, const void *key, uint64_t key_hash) {
+    size_t idx;
+    if (!find_index(ht, key, key_hash, &idx)) {
+        return false;
+    }
+    for (size_t next = next_slot(ht, idx); ht->ctrl[next] > 1; next = next_slot(ht, next)) {
+        move_slot(ht, idx, next, ht->ctrl[next] - 1);
+        idx = next;
+    }
+    ht->ctrl[idx] = 0;
+    ht->count--;
+    return true;
+}
+
+void ht_robin_hood_clear(Hashtable *ht) {
+    memset(ht->ctrl, 0, ht->arr_cap);
+    ht->count = 0;
+}
+
+// the chain of an entry is its probe distance, which ctrl already holds
+void ht_robin_hood_stats(const Hashtable *ht, HTStats *out) {
+    size_t empty = 0, total = 0;
+    for (size_t i = 0; i < ht->arr_cap; i++) {
+        if (ht->ctrl[i] == 0) {
+            empty++;
+            continue;
+        }
+        total += ht->ctrl[i];
+        ht_stats_record(out, ht->ctrl[i]);
+    }
+    out->empty_ratio = (double)empty / ht->arr_cap;
+    out->mean_chain = ht->count ? (double)total / ht->count : 0.0;
+    out->bucket_bytes = ht->arr_cap * (ht->entry_size + 1 + sizeof(uint64_t));
+}
+
+void ht_robin_hood_deinit(Hashtable *ht) {
+    free(ht->ctrl);
+    free(ht->slots);
+    free(ht->hashes);
+    ht->ctrl = NULL;
+    ht->slots = NULL;
+    ht->hashes = NULL;
+    ht->count = 0;
+    ht->arr_cap = 0;
+}
@@ -0,0 +1,153 @@
+#include "ht_sharded.h"
+#include "ht_internal.h"
+#include <assert.h>
+
+// A key is hashed once here and the hash is handed to the shard through the
+// ht_*_hashed entry points. The shard takes the top bits of the hash, while a
+// shard places keys by the low bits, a prime modulo or a Fibonacci product of
+// the hash, so keys of one shard still spread over all of its buckets.
+
+static HTShard *shard_of(HTSharded *sh, uint64_t key_hash) {
+    if (sh->shard_bits == 0) {
+        return sh->shards;
+    }
+    return &sh->shards[key_hash >> (64 - sh->shard_bits)];
+}
+
+bool ht_sharded_init(HTSharded *sh, size_t key_size, size_t value_size, size_t shards, const HTConfig *config) {
+    if (!sh) {
+        fprintf(stderr, "A valid hashtable pointer is required for init\n");
+        return false;
+    }
+    if (key_size == HT_VARLEN_KEY) {
+        fprintf(stderr, "Sharded tables need a fixed key_size\n");
+        return false;
+    }
+    sh->shard_count = 1;
+    sh->shard_bits = 0;
+    while (sh->shard_count < (shards ? shards : HT_SHARDED_DEFAULT_SHARDS)) {
+        sh->shard_count <<= 1;
+        sh->shard_bits++;
+    }
+    sh->key_size = key_size;
+    sh->value_size = value_size;
+    sh->shards = (HTShard *)aligned_alloc(_Alignof(HTShard), sh->shard_count * sizeof(HTShard));
+    if (!sh->shards) {
+        fprintf(stderr, "Failed to allocate shards during ht_sharded_init\n");
+        return false;
+    }
+    for (size_t i = 0; i < sh->shard_count; i++) {
+        if (!ht_init_with(&sh->shards[i].table, key_size, value_size, config)) {
+            fprintf(stderr, "Failed to init shard %zu during ht_sharded_init\n", i);
+            while (i-- > 0) {
+                ht_deinit(&sh->shards[i].table);
+                pthread_mutex_destroy(&sh->shards[i].lock);
+            }
+            free(sh->shards);
+            sh->shards = NULL;
+            return false;
+        }
+        pthread_mutex_init(&sh->shards[i].lock, NULL);
+    }
+    sh->hash_fn = sh->shards[0].table.hash_fn;
+    return true;
+}
+
+HTSharded *_ht_sharded_create(size_t key_size, size_t value_size, size_t shards, const HTConfig *config) {
+    HTSharded *sh = (HTSharded *)malloc(sizeof(HTSharded));
+    if (!sh) {
+        fprintf(stderr, "Failed to allocate hashtable during ht_sharded_create\n");
+        return NULL;
+    }
+    if (!ht_sharded_init(sh, key_size, value_size, shards, config)) {
+        fprintf(stderr, "Failed to call ht_sharded_init during ht_sharded_create\n");
+        free(sh);
+        return NULL;
+    }
+    return sh;
+}
+
+bool ht_sharded_put(HTSharded *sh, const void *key, const void *value) {
+    assert(sh); assert(key); assert(value);
+    uint64_t key_hash = sh->hash_fn(key, sh->key_size);
+    HTShard *shard = shard_of(sh, key_hash);
+    pthread_mutex_lock(&shard->lock);
+    bool ok = ht_put_hashed(&shard->table, key, value, key_hash);
+    pthread_mutex_unlock(&shard->lock);
+    return ok;
+}
+
+bool ht_sharded_get(HTSharded *sh, const void *key, void *out_value) {
+    assert(sh); assert(key); assert(out_value);
+    uint64_t key_hash = sh->hash_fn(key, sh->key_size);
+    HTShard *shard = shard_of(sh, key_hash);
+    pthread_mutex_lock(&shard->lock);
+    void *value = ht_find_hashed(&shard->table, key, key_hash);
+    if (value) {
+        memcpy(out_value, value, sh->value_size);
+    }
+    pthread_mutex_unlock(&shard->lock);
+    return value != NULL;
+}
+
+bool ht_sharded_contains(HTSharded *sh, const void *key) {
+    assert(sh); assert(key);
+    uint64_t key_hash = sh->hash_fn(key, sh->key_size);
+    HTShard *shard = shard_of(sh, key_hash);
+    pthread_mutex_lock(&shard->lock);
+    bool found = ht_find_hashed(&shard->table, key, key_hash) != NULL;
+    pthread_mutex_unlock(&shard->lock);
+    return found;
+}
+
+bool ht_sharded_delete(HTSharded *sh, const void *key) {
+    assert(sh); assert(key);
+    uint64_t key_hash = sh->hash_fn(key, sh->key_size);
+    HTShard *shard = shard_of(sh, key_hash);
+    pthread_mutex_lock(&shard->lock);
+    // an empty shard is normal here, unlike ht_delete on an empty table
+    bool found = !ht_empty(&shard->table) && ht_delete_hashed(&shard->table, key, key_hash);
+    pthread_mutex_unlock(&shard->lock);
+    return found;
+}
+
+// shards are cleared one at a time, the others stay usable meanwhile
+void ht_sharded_clear(HTSharded *sh) {
+    assert(sh);
+    for (size_t i = 0; i < sh->shard_count; i++) {
+        pthread_mutex_lock(&sh->shards[i].lock);
+        ht_clear(&sh->shards[i].table);
+        pthread_mutex_unlock(&sh->shards[i].lock);
+    }
+}
+
+size_t ht_sharded_count(HTSharded *sh) {
+    assert(sh);
+    size_t count = 0;
+    for (size_t i = 0; i < sh->shard_count; i++) {
+        pthread_mutex_lock(&sh->shards[i].lock);
+        count += ht_count(&sh->shards[i].table);
+        pthread_mutex_unlock(&sh->shards[i].lock);
+    }
+    return count;
+}
+
+// no other thread may use the table any more
+void ht_sharded_deinit(HTSharded *sh) {
+    for (size_t i = 0; i < sh->shard_count; i++) {
+        ht_deinit(&sh->shards[i].table);
+        pthread_mutex_destroy(&sh->shards[i].lock);
+    }
+    free(sh->shards);
+    sh->shards = NULL;
+    sh->shard_count = 0;
+    sh->shard_bits = 0;
+}
+
+void _ht_sharded_destroy(HTSharded **sh_ptr) {
+    if (sh_ptr && *(sh_ptr)) {
+        ht_sharded_deinit(*sh_ptr);
+        free(*sh_ptr);
+        *sh_ptr = NULL;
+    }
+}
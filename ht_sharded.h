@@ -0,0 +1,47 @@
+#ifndef HT_SHARDED_H
+#define HT_SHARDED_H
+
+#include "hashtable.h"
+#include <pthread.h>
+
+// Thread safe front end over independent tables. The top bits of a key's hash
+// pick its shard, and every shard is a full Hashtable of the configured backend
+// with its own lock, so a resize only pauses the writers of one shard and only
+// moves that shard's share of the entries.
+typedef struct HTShard {
+    pthread_mutex_t lock;
+    Hashtable table;
+} __attribute__((aligned(64))) HTShard; // one cache line or more per shard, no false sharing
+
+typedef struct HTSharded {
+    HTShard *shards;
+    size_t shard_count; // power of two
+    unsigned int shard_bits;
+    HTHashFunc hash_fn;
+    size_t key_size;
+    size_t value_size;
+} HTSharded;
+
+#define HT_SHARDED_DEFAULT_SHARDS 16
+
+// shards is rounded up to a power of two, 0 picks HT_SHARDED_DEFAULT_SHARDS,
+// config applies to every shard and may be NULL
+bool ht_sharded_init(HTSharded *sh, size_t key_size, size_t value_size, size_t shards, const HTConfig *config);
+HTSharded *_ht_sharded_create(size_t key_size, size_t value_size, size_t shards, const HTConfig *config);
+// takes type of key, and type of value
+#define ht_sharded_create(key_size, value_size, shards, config) _ht_sharded_create(sizeof(key_size), sizeof(value_size), shards, config)
+void ht_sharded_deinit(HTSharded *sh);
+void _ht_sharded_destroy(HTSharded **sh);
+#define ht_sharded_destroy(sh) _ht_sharded_destroy(&sh);
+
+bool ht_sharded_put(HTSharded *sh, const void *key, const void *value);
+// copies the value out under the shard lock like ht_get
+bool ht_sharded_get(HTSharded *sh, const void *key, void *out_value);
+bool ht_sharded_contains(HTSharded *sh, const void *key);
+// returns whether the key was present
+bool ht_sharded_delete(HTSharded *sh, const void *key);
+void ht_sharded_clear(HTSharded *sh);
+// sum of the shard counts, each read under its shard's lock
+size_t ht_sharded_count(HTSharded *sh);
+
+#endif // HT_SHARDED_H
@@ -0,0 +1,106 @@
+#include "ht_internal.h"
+#include <assert.h>
+
+// Fixed size node allocator owned by a chained table. Nodes are carved in order
+// from a list of chunks that grow geometrically, and freed nodes go on an
+// intrusive free list through HTNode.next. Chunks are only returned to malloc by
+// ht_slab_deinit, ht_slab_reset just rewinds to the first chunk so a cleared
+// table refills the memory it already has.
+
+#define SLAB_FIRST_CHUNK 64
+#define SLAB_MAX_CHUNK (1 << 20) // nodes, later chunks stop doubling past this
+
+void ht_slab_init(HTSlab *slab, size_t node_size) {
+    memset(slab, 0, sizeof(HTSlab));
+    slab->node_size = node_size;
+    slab->next_chunk_nodes = SLAB_FIRST_CHUNK;
+}
+
+// NULL when malloc fails or the chunk size does not fit a size_t
+static HTSlabChunk *new_chunk(HTSlab *slab, size_t nodes) {
+    if (nodes > (SIZE_MAX - sizeof(HTSlabChunk)) / slab->node_size) {
+        return NULL;
+    }
+    HTSlabChunk *chunk = (HTSlabChunk *)malloc(sizeof(HTSlabChunk) + nodes * slab->node_size);
+    if (!chunk) {
+        return NULL;
+    }
+    chunk->next = NULL;
+    chunk->nodes = nodes;
+    slab->chunk_bytes += sizeof(HTSlabChunk) + nodes * slab->node_size;
+    if (slab->next_chunk_nodes < SLAB_MAX_CHUNK) {
+        slab->next_chunk_nodes *= 2;
+    }
+    return chunk;
+}
+
+// makes curr a chunk with at least n uncarved nodes, moving on to chunks kept
+// by a reset or linking a new one in after curr. The unused tail of a skipped
+// chunk is picked up again after the next reset.
+static bool ensure_room(HTSlab *slab, size_t n) {
+    if (slab->curr && slab->curr->nodes - slab->curr_used >= n) {
+        return true;
+    }
+    HTSlabChunk *next = slab->curr ? slab->curr->next : slab->chunks;
+    if (next && next->nodes >= n) {
+        slab->curr = next;
+        slab->curr_used = 0;
+        return true;
+    }
+    size_t nodes = slab->next_chunk_nodes > n ? slab->next_chunk_nodes : n;
+    HTSlabChunk *chunk = new_chunk(slab, nodes);
+    if (!chunk) {
+        return false;
+    }
+    if (slab->curr) {
+        chunk->next = slab->curr->next;
+        slab->curr->next = chunk;
+    } else {
+        chunk->next = slab->chunks;
+        slab->chunks = chunk;
+    }
+    slab->curr = chunk;
+    slab->curr_used = 0;
+    return true;
+}
+
+HTNode *ht_slab_alloc(HTSlab *slab) {
+    HTNode *node = slab->free_list;
+    if (node) {
+        slab->free_list = node->next;
+        return node;
+    }
+    if (!ensure_room(slab, 1)) {
+        return NULL;
+    }
+    return (HTNode *)((unsigned char *)slab->curr->data + slab->curr_used++ * slab->node_size);
+}
+
+// n nodes laid out back to back, node_size bytes apart, for bulk loads
+HTNode *ht_slab_alloc_run(HTSlab *slab, size_t n) {
+    if (n == 0 || !ensure_room(slab, n)) {
+        return NULL;
+    }
+    HTNode *run = (HTNode *)((unsigned char *)slab->curr->data + slab->curr_used * slab->node_size);
+    slab->curr_used += n;
+    return run;
+}
+
+void ht_slab_free(HTSlab *slab, HTNode *node) {
+    node->next = slab->free_list;
+    slab->free_list = node;
+}
+
+void ht_slab_reset(HTSlab *slab) {
+    slab->curr = NULL;
+    slab->curr_used = 0;
+    slab->free_list = NULL;
+}
+
+void ht_slab_deinit(HTSlab *slab) {
+    for (HTSlabChunk *chunk = slab->chunks, *next; chunk != NULL; chunk = next) {
+        next = chunk->next;
+        free(chunk);
+    }
+    ht_slab_init(slab, slab->node_size);
+}
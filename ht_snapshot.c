@@ -0,0 +1,236 @@
+#include "ht_internal.h"
+#include <assert.h>
+#include <sys/stat.h>
+
+// Snapshot file layout, native byte order:
+//   HTSnapshotHeader
+//   count records of [uint64_t hash][key_size key bytes][value_size value bytes]
+// Records are packed without padding. The hashes are the ones the table already
+// cached, so a load links every entry by its stored hash and never calls the
+// hash function. A snapshot from a machine of the other byte order fails the
+// version check.
+
+#define HT_SNAPSHOT_MAGIC "HTSNAP\0\0"
+#define HT_SNAPSHOT_VERSION 1
+#define HT_SNAPSHOT_BUF (1 << 20) // bytes of records gathered per fwrite / fread
+
+typedef struct HTSnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t hash_kind; // HTHashKind the cached hashes were computed with
+    uint32_t backend;
+    uint32_t cap_policy;
+    uint64_t key_size;
+    uint64_t value_size;
+    uint64_t count;
+} HTSnapshotHeader;
+
+typedef struct SnapshotWriter {
+    FILE *file;
+    unsigned char *buf;
+    size_t used;
+    size_t record_size;
+    size_t key_size;
+    size_t value_size;
+    bool failed;
+} SnapshotWriter;
+
+static void write_record(uint64_t key_hash, const void *key, const void *value, void *ctx) {
+    SnapshotWriter *w = ctx;
+    if (w->used + w->record_size > HT_SNAPSHOT_BUF) {
+        w->failed |= fwrite(w->buf, 1, w->used, w->file) != w->used;
+        w->used = 0;
+    }
+    unsigned char *rec = w->buf + w->used;
+    memcpy(rec, &key_hash, sizeof(uint64_t));
+    memcpy(rec + sizeof(uint64_t), key, w->key_size);
+    memcpy(rec + sizeof(uint64_t) + w->key_size, value, w->value_size);
+    w->used += w->record_size;
+}
+
+// Writes to path.tmp and renames it over path once complete, so a crash during
+// the save leaves any earlier snapshot at path intact.
+bool ht_save(const Hashtable *ht, const char *path) {
+    assert(ht); assert(path);
+    if (ht->key_size == HT_VARLEN_KEY) {
+        fprintf(stderr, "ht_save needs a fixed key_size\n");
+        return false;
+    }
+    size_t record_size = sizeof(uint64_t) + ht->key_size + ht->value_size;
+    if (record_size > HT_SNAPSHOT_BUF) {
+        fprintf(stderr, "ht_save records of %zu bytes exceed the %d byte limit\n", record_size, HT_SNAPSHOT_BUF);
+        return false;
+    }
+    size_t tmp_len = strlen(path) + sizeof(".tmp");
+    char *tmp_path = (char *)malloc(tmp_len);
+    unsigned char *buf = (unsigned char *)malloc(HT_SNAPSHOT_BUF);
+    if (!tmp_path || !buf) {
+        fprintf(stderr, "Failed to allocate buffers during ht_save\n");
+        free(tmp_path);
+        free(buf);
+        return false;
+    }
+    snprintf(tmp_path, tmp_len, "%s.tmp", path);
+    FILE *file = fopen(tmp_path, "wb");
+    if (!file) {
+        fprintf(stderr, "Failed to open %s during ht_save\n", tmp_path);
+        free(tmp_path);
+        free(buf);
+        return false;
+    }
+
+    HTSnapshotHeader header = {
+        .magic = HT_SNAPSHOT_MAGIC,
+        .version = HT_SNAPSHOT_VERSION,
+        .hash_kind = ht->hash_kind,
+        .backend = ht->backend,
+        .cap_policy = ht->cap_policy,
+        .key_size = ht->key_size,
+        .value_size = ht->value_size,
+        .count = ht->count,
+    };
+    SnapshotWriter w = {
+        .file = file, .buf = buf, .record_size = record_size,
+        .key_size = ht->key_size, .value_size = ht->value_size,
+    };
+    w.failed = fwrite(&header, sizeof(header), 1, file) != 1;
+    ht_foreach_hashed(ht, write_record, &w);
+    w.failed |= fwrite(buf, 1, w.used, file) != w.used;
+    w.failed |= fclose(file) != 0;
+    free(buf);
+
+    if (w.failed || rename(tmp_path, path) != 0) {
+        fprintf(stderr, "Failed to write %s during ht_save\n", path);
+        remove(tmp_path);
+        free(tmp_path);
+        return false;
+    }
+    free(tmp_path);
+    return true;
+}
+
+Hashtable *ht_load(const char *path) {
+    return ht_load_with(path, NULL);
+}
+
+// Reads the records in large blocks. The table is sized for the whole count
+// before the first record, chained entries are copied into one contiguous run
+// of slab nodes and pushed on their bucket, and open addressing entries are put
+// with their stored hash.
+static bool read_entries(Hashtable *ht, FILE *file, size_t count) {
+    size_t record_size = sizeof(uint64_t) + ht->key_size + ht->value_size;
+    size_t per_block = HT_SNAPSHOT_BUF / record_size;
+    unsigned char *buf = (unsigned char *)malloc(per_block * record_size);
+    unsigned char *nodes = NULL;
+    if (ht->backend == HT_CHAINED && count > 0) {
+        nodes = (unsigned char *)ht_slab_alloc_run(&ht->slab, count);
+    }
+    if (!buf || (ht->backend == HT_CHAINED && count > 0 && !nodes)) {
+        fprintf(stderr, "Failed to allocate memory during ht_load\n");
+        free(buf);
+        return false;
+    }
+
+    size_t done = 0;
+    while (done < count) {
+        size_t block = count - done < per_block ? count - done : per_block;
+        if (fread(buf, record_size, block, file) != block) {
+            fprintf(stderr, "Snapshot ended after %zu of %zu entries in ht_load\n", done, count);
+            free(buf);
+            return false;
+        }
+        for (size_t i = 0; i < block; i++) {
+            const unsigned char *rec = buf + i * record_size;
+            uint64_t key_hash;
+            memcpy(&key_hash, rec, sizeof(uint64_t));
+            const unsigned char *key = rec + sizeof(uint64_t);
+            const unsigned char *value = key + ht->key_size;
+            if (ht->backend != HT_CHAINED) {
+                if (!ht_put_hashed(ht, key, value, key_hash)) {
+                    free(buf);
+                    return false;
+                }
+                continue;
+            }
+            // keys of a snapshot are distinct, no chain has to be searched
+            HTNode *node = (HTNode *)(nodes + (done + i) * ht->slab.node_size);
+            memcpy(ht_node_key(node), key, ht->key_size);
+            memcpy(ht_node_value(ht, node), value, ht->value_size);
+            ht_link_node(ht, node, key_hash);
+        }
+        done += block;
+    }
+    free(buf);
+    return true;
+}
+
+// config may pick another backend or capacity policy than the saved table had,
+// its hash kind must match the snapshot's and it has to supply the hash_fn of
+// an HT_HASH_CUSTOM snapshot. A NULL config rebuilds the saved configuration.
+Hashtable *ht_load_with(const char *path, const HTConfig *config) {
+    assert(path);
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "Failed to open %s during ht_load\n", path);
+        return NULL;
+    }
+    HTSnapshotHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1
+        || memcmp(header.magic, HT_SNAPSHOT_MAGIC, sizeof(header.magic)) != 0
+        || header.version != HT_SNAPSHOT_VERSION) {
+        fprintf(stderr, "%s is not a hashtable snapshot\n", path);
+        fclose(file);
+        return NULL;
+    }
+    if (header.backend > HT_ROBIN_HOOD || header.cap_policy > HT_CAP_POW2 || header.hash_kind > HT_HASH_CUSTOM) {
+        fprintf(stderr, "%s is a corrupt snapshot, backend %u, cap_policy %u and hash_kind %u\n", path,
+                (unsigned)header.backend, (unsigned)header.cap_policy, (unsigned)header.hash_kind);
+        fclose(file);
+        return NULL;
+    }
+    HTConfig saved = {
+        .backend = (HTBackend)header.backend,
+        .hash = (HTHashKind)header.hash_kind,
+        .cap_policy = (HTCapPolicy)header.cap_policy,
+    };
+    if (!config) {
+        config = &saved;
+    }
+    if (config->hash != saved.hash) {
+        fprintf(stderr, "ht_load config hash kind %d differs from the snapshot's %d\n", config->hash, saved.hash);
+        fclose(file);
+        return NULL;
+    }
+
+    // a record has to fit the read buffer, which also keeps the sizes from overflowing
+    if (header.key_size == HT_VARLEN_KEY || header.key_size > HT_SNAPSHOT_BUF || header.value_size > HT_SNAPSHOT_BUF
+        || sizeof(uint64_t) + header.key_size + header.value_size > HT_SNAPSHOT_BUF) {
+        fprintf(stderr, "%s is a corrupt snapshot, key_size %llu and value_size %llu\n", path,
+                (unsigned long long)header.key_size, (unsigned long long)header.value_size);
+        fclose(file);
+        return NULL;
+    }
+    // the file has to hold every record the header counts, before anything is sized for them
+    size_t record_size = sizeof(uint64_t) + header.key_size + header.value_size;
+    struct stat st;
+    if (fstat(fileno(file), &st) != 0 || header.count > ((uint64_t)st.st_size - sizeof(header)) / record_size) {
+        fprintf(stderr, "%s is a corrupt snapshot, it is too short for %llu entries\n", path, (unsigned long long)header.count);
+        fclose(file);
+        return NULL;
+    }
+
+    Hashtable *ht = _ht_create_with(header.key_size, header.value_size, config);
+    if (!ht) {
+        fprintf(stderr, "Failed to create table during ht_load\n");
+        fclose(file);
+        return NULL;
+    }
+    if (!ht_reserve(ht, header.count) || !read_entries(ht, file, header.count)) {
+        fprintf(stderr, "Failed to load %s\n", path);
+        ht_destroy(ht);
+        fclose(file);
+        return NULL;
+    }
+    fclose(file);
+    return ht;
+}
@@ -0,0 +1,305 @@
+#include "ht_internal.h"
+#include <assert.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Open addressing backend in the style of SwissTable. Every slot has a control
+// byte which is either EMPTY, DELETED or the low 7 bits of the slot's hash. Slots
+// are probed a group of 16 at a time, comparing all 16 control bytes against the
+// hash fragment at once, so the key memory is only touched for likely matches.
+// Groups are aligned and visited in triangular order over a power of two number
+// of groups, which reaches every group exactly once.
+
+#define GROUP_WIDTH 16
+#define CTRL_EMPTY ((uint8_t)0x80)
+#define CTRL_DELETED ((uint8_t)0xFE)
+#define MIN_CAP GROUP_WIDTH
+
+#define h1(hash) ((hash) >> 7)
+#define h2(hash) ((uint8_t)((hash) & 0x7F))
+
+// slots usable before a rehash, keeps the load factor at or below 7/8
+static size_t max_load(size_t cap) {
+    return cap - cap / 8;
+}
+
+#if defined(__SSE2__)
+// bitmask of the slots in the group whose control byte equals byte
+static inline unsigned int group_match(const uint8_t *group, uint8_t byte) {
+    __m128i ctrl = _mm_load_si128((const __m128i *)group);
+    return (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char)byte)));
+}
+
+// bitmask of the EMPTY or DELETED slots in the group, both have the high bit set
+static inline unsigned int group_match_available(const uint8_t *group) {
+    return (unsigned int)_mm_movemask_epi8(_mm_load_si128((const __m128i *)group));
+}
+#else
+static inline unsigned int group_match(const uint8_t *group, uint8_t byte) {
+    unsigned int mask = 0;
+    for (int i = 0; i < GROUP_WIDTH; i++) {
+        mask |= (unsigned int)(group[i] == byte) << i;
+    }
+    return mask;
+}
+
+static inline unsigned int group_match_available(const uint8_t *group) {
+    unsigned int mask = 0;
+    for (int i = 0; i < GROUP_WIDTH; i++) {
+        mask |= (unsigned int)(group[i] >> 7) << i;
+    }
+    return mask;
+}
+#endif
+
+static size_t next_pow2(size_t x) {
+    size_t cap = MIN_CAP;
+    while (cap < x) {
+        cap <<= 1;
+    }
+    return cap;
+}
+
+static bool alloc_arrays(Hashtable *ht, size_t cap) {
+    if (cap > SIZE_MAX / ht->entry_size || cap > SIZE_MAX / sizeof(uint64_t)) {
+        return false;
+    }
+    uint8_t *ctrl = (uint8_t *)aligned_alloc(GROUP_WIDTH, cap);
+    unsigned char *slots = (unsigned char *)malloc(cap * ht->entry_size);
+    uint64_t *hashes = (uint64_t *)malloc(cap * sizeof(uint64_t));
+    if (!ctrl || !slots || !hashes) {
+        free(ctrl);
+        free(slots);
+        free(hashes);
+        return false;
+    }
+    memset(ctrl, CTRL_EMPTY, cap);
+    ht->ctrl = ctrl;
+    ht->slots = slots;
+    ht->hashes = hashes;
+    ht->arr_cap = cap;
+    ht->growth_left = max_load(cap);
+    return true;
+}
+
+bool ht_swiss_init(Hashtable *ht, size_t min_cap) {
+    if (!alloc_arrays(ht, next_pow2(min_cap))) {
+        fprintf(stderr, "Failed to allocate slot arrays during ht_init\n");
+        return false;
+    }
+    return true;
+}
+
+// index of the first EMPTY or DELETED slot on the probe sequence of key_hash
+static size_t find_available(const Hashtable *ht, uint64_t key_hash) {
+    size_t group_mask = ht->arr_cap / GROUP_WIDTH - 1;
+    size_t group = h1(key_hash) & group_mask;
+    for (size_t step = 1; ; step++) {
+        size_t base = group * GROUP_WIDTH;
+        unsigned int available = group_match_available(ht->ctrl + base);
+        if (available) {
+            return base + (size_t)__builtin_ctz(available);
+        }
+        group = (group + step) & group_mask;
+    }
+}
+
+// index of the slot holding key. On a miss *found is false and the index is the
+// first EMPTY or DELETED slot the probe passed, the one find_available returns,
+// so an insert right after the lookup needs no second probe.
+static size_t find_index(const Hashtable *ht, const void *key, uint64_t key_hash, bool *found) {
+    size_t group_mask = ht->arr_cap / GROUP_WIDTH - 1;
+    size_t group = h1(key_hash) & group_mask;
+    uint8_t fragment = h2(key_hash);
+    size_t available_idx = SIZE_MAX;
+    HT_COUNT(ht, lookups, 1);
+    for (size_t step = 1; step <= group_mask + 1; step++) {
+        HT_COUNT(ht, probes, 1);
+        size_t base = group * GROUP_WIDTH;
+        const uint8_t *ctrl = ht->ctrl + base;
+        for (unsigned int match = group_match(ctrl, fragment); match; match &= match - 1) {
+            size_t idx = base + (size_t)__builtin_ctz(match);
+            // the 7 bit fragment already filters out most mismatches, going
+            // straight to the key saves touching the hashes array
+            if (memcmp(key, ht_slot_at(ht, idx), ht->key_size) == 0) {
+                *found = true;
+                return idx;
+            }
+        }
+        unsigned int available = group_match_available(ctrl);
+        if (available && available_idx == SIZE_MAX) {
+            available_idx = base + (size_t)__builtin_ctz(available);
+        }
+        if (group_match(ctrl, CTRL_EMPTY)) {
+            break;
+        }
+        group = (group + step) & group_mask;
+    }
+    *found = false;
+    return available_idx;
+}
+
+// moves every live slot into freshly allocated arrays of new_cap slots,
+// the stored hashes are reused so no key is hashed again
+static bool rehash(Hashtable *ht, size_t new_cap) {
+    Hashtable old = *ht;
+    if (!alloc_arrays(ht, new_cap)) {
+        *ht = old;
+        return false;
+    }
+    for (size_t i = 0; i < old.arr_cap; i++) {
+        if (old.ctrl[i] & 0x80) {
+            continue;
+        }
+        uint64_t key_hash = old.hashes[i];
+        size_t idx = find_available(ht, key_hash);
+        ht->ctrl[idx] = h2(key_hash);
+        ht->hashes[idx] = key_hash;
+        memcpy(ht_slot_at(ht, idx), ht_slot_at(&old, i), ht->entry_size);
+    }
+    ht->growth_left = max_load(ht->arr_cap) - ht->count;
+    free(old.ctrl);
+    free(old.slots);
+    free(old.hashes);
+    HT_COUNT(ht, resizes, 1);
+    return true;
+}
+
+bool ht_swiss_resize(Hashtable *ht, size_t new_cap) {
+    size_t min_cap = next_pow2(new_cap);
+    while (max_load(min_cap) <= ht->count) {
+        min_cap <<= 1;
+    }
+    if (!rehash(ht, min_cap)) {
+        fprintf(stderr, "ht_resize, failed to allocate new slot arrays, old ht preserved\n");
+        return false;
+    }
+    return true;
+}
+
+// slot holding key, or a newly claimed one with the key copied in and the value
+// left to the caller. NULL when growing the table fails.
+static unsigned char *claim_slot(Hashtable *ht, const void *key, uint64_t key_hash, bool *found) {
+    size_t idx = find_index(ht, key, key_hash, found);
+    if (*found) {
+        return ht_slot_at(ht, idx);
+    }
+
+    // a tombstone is reused without growing, only claiming an EMPTY slot uses up growth_left
+    if (ht->growth_left == 0 && ht->ctrl[idx] == CTRL_EMPTY) {
+        // mostly tombstones means a same size rehash is enough to reclaim them
+        size_t new_cap = ht->count < max_load(ht->arr_cap) / 2 ? ht->arr_cap : 2 * ht->arr_cap;
+        if (!rehash(ht, new_cap)) {
+            fprintf(stderr, "Failed to grow slot arrays in ht_put\n");
+            return NULL;
+        }
+        idx = find_available(ht, key_hash);
+    }
+
+    if (ht->ctrl[idx] == CTRL_EMPTY) {
+        ht->growth_left--;
+    }
+    ht->ctrl[idx] = h2(key_hash);
+    ht->hashes[idx] = key_hash;
+    unsigned char *slot = ht_slot_at(ht, idx);
+    memcpy(slot, key, ht->key_size);
+    ht->count++;
+    return slot;
+}
+
+bool ht_swiss_put(Hashtable *ht, const void *key, const void *value, uint64_t key_hash) {
+    bool found;
+    unsigned char *slot = claim_slot(ht, key, key_hash, &found);
+    if (!slot) {
+        return false;
+    }
+    memcpy(ht_slot_value(ht, slot), value, ht->value_size);
+    return true;
+}
+
+void *ht_swiss_get_or_insert(Hashtable *ht, const void *key, uint64_t key_hash, bool *inserted) {
+    bool found;
+    unsigned char *slot = claim_slot(ht, key, key_hash, &found);
+    if (!slot) {
+        return NULL;
+    }
+    *inserted = !found;
+    if (!found) {
+        memset(ht_slot_value(ht, slot), 0, ht->value_size);
+    }
+    return ht_slot_value(ht, slot);
+}
+
+void *ht_swiss_find(const Hashtable *ht, const void *key, uint64_t key_hash) {
+    bool found;
+    size_t idx = find_index(ht, key, key_hash, &found);
+    return found ? ht_slot_value(ht, ht_slot_at(ht, idx)) : NULL;
+}
+
+// pulls in the first group probed for key_hash ahead of a batched lookup
+void ht_swiss_prefetch(const Hashtable *ht, uint64_t key_hash) {
+    size_t base = (h1(key_hash) & (ht->arr_cap / GROUP_WIDTH - 1)) * GROUP_WIDTH;
+    __builtin_prefetch(ht->ctrl + base);
+    __builtin_prefetch(ht_slot_at(ht, base));
+}
+
+bool ht_swiss_delete(Hashtable *ht, const void *key, uint64_t key_hash) {
+    bool found;
+    size_t idx = find_index(ht, key, key_hash, &found);
+    if (!found) {
+        return false;
+    }
+    // a group that still has an EMPTY slot never stopped a probe from reaching
+    // a later group, so the slot can go back to EMPTY instead of a tombstone
+    const uint8_t *group = ht->ctrl + (idx & ~(size_t)(GROUP_WIDTH - 1));
+    if (group_match(group, CTRL_EMPTY)) {
+        ht->ctrl[idx] = CTRL_EMPTY;
+        ht->growth_left++;
+    } else {
+        ht->ctrl[idx] = CTRL_DELETED;
+    }
+    ht->count--;
+    return true;
+}
+
+void ht_swiss_clear(Hashtable *ht) {
+    memset(ht->ctrl, CTRL_EMPTY, ht->arr_cap);
+    ht->growth_left = max_load(ht->arr_cap);
+    ht->count = 0;
+}
+
+// the chain of an entry is the number of groups a lookup of it visits
+void ht_swiss_stats(const Hashtable *ht, HTStats *out) {
+    size_t group_mask = ht->arr_cap / GROUP_WIDTH - 1;
+    size_t empty = 0, total = 0;
+    for (size_t i = 0; i < ht->arr_cap; i++) {
+        if (ht->ctrl[i] & 0x80) {
+            empty += ht->ctrl[i] == CTRL_EMPTY;
+            continue;
+        }
+        size_t group = h1(ht->hashes[i]) & group_mask;
+        size_t len = 1;
+        while (group != i / GROUP_WIDTH) {
+            group = (group + len) & group_mask;
+            len++;
+        }
+        total += len;
+        ht_stats_record(out, len);
+    }
+    out->empty_ratio = (double)empty / ht->arr_cap;
+    out->mean_chain = ht->count ? (double)total / ht->count : 0.0;
+    out->bucket_bytes = ht->arr_cap * (ht->entry_size + 1 + sizeof(uint64_t));
+}
+
+void ht_swiss_deinit(Hashtable *ht) {
+    free(ht->ctrl);
+    free(ht->slots);
+    free(ht->hashes);
+    ht->ctrl = NULL;
+    ht->slots = NULL;
+    ht->hashes = NULL;
+    ht->count = 0;
+    ht->arr_cap = 0;
+}
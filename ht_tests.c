@@ -2,6 +2,13 @@
 #include <string.h>
 #include <assert.h>
 #include "hashtable.h" // Include your hashtable implementation header here
+#include "ht_concurrent.h"
+#include "ht_sharded.h"
+#include "ht_frozen.h"
+#include "ht_perfect.h"
+#include "ht_define.h"
+#include "test_cases.h"
+#include <unistd.h>
 
 void test_basic_insertion_and_retrieval() {
     printf("Running basic insertion and retrieval test...\n");
@@ -47,7 +54,7 @@ void test_resize() {
         int y = i;
         assert(ht_put(ht, &x, &y));
     }
-    unsigned int old_cap = ht->arr_cap;
+    size_t old_cap = ht->arr_cap;
     unsigned int old_count = ht->count;
     ht_resize(ht, 1500);
     assert(ht);
@@ -181,13 +188,1111 @@ void test_ht_stack() {
         assert(ht_get(&ht_stack, &i, &out_int));
         assert(out_int != 9000 && out_int == i);
     }
-    //TODO: ht_deinit causes some sort of memory error 
-    //FIXME:
-    // ht_deinit(&ht_stack);
+    ht_deinit(&ht_stack);
 
     printf("Passed test for stack managed hashtable, ht_init and ht_deinit\n");
 }
 
+void test_backend(HTConfig config, const char *name) {
+    printf("Running %s backend test...\n", name);
+    Hashtable *ht = ht_create_with(int, long, &config);
+    assert(ht);
+
+    for (int i = 0; i < 10000; i++) {
+        long value = (long)i * 3;
+        assert(ht_put(ht, &i, &value));
+    }
+    assert(ht_count(ht) == 10000);
+    for (int i = 0; i < 10000; i++) {
+        long *found = ht_find(ht, &i);
+        assert(found && *found == (long)i * 3);
+    }
+    int missing = -1;
+    assert(!ht_contains(ht, &missing));
+
+    long overwrite = 7;
+    int key = 42;
+    assert(ht_put(ht, &key, &overwrite));
+    assert(ht_count(ht) == 10000);
+    long out = 0;
+    assert(ht_get(ht, &key, &out) && out == 7);
+
+    // delete the even keys, then put them back to reuse freed slots
+    for (int i = 0; i < 10000; i += 2) {
+        ht_delete(ht, &i);
+    }
+    assert(ht_count(ht) == 5000);
+    for (int i = 0; i < 10000; i++) {
+        assert(ht_contains(ht, &i) == (i % 2 == 1));
+    }
+    for (int round = 0; round < 20; round++) {
+        for (int i = 0; i < 10000; i += 2) {
+            long value = i;
+            assert(ht_put(ht, &i, &value));
+        }
+        for (int i = 0; i < 10000; i += 2) {
+            ht_delete(ht, &i);
+        }
+    }
+    assert(ht_count(ht) == 5000);
+    for (int i = 1; i < 10000; i += 2) {
+        long *found = ht_find(ht, &i);
+        assert(found && *found == (long)i * 3);
+    }
+
+    if (config.backend == HT_SWISS) {
+        // a key deleted from a full group leaves a tombstone, putting it back
+        // needs no growth left and does not rebuild the table
+        Hashtable *full = ht_create_with(int, long, &config);
+        assert(ht_resize(full, 1024));
+        long value = 0;
+        int count = 0;
+        for (; full->growth_left > 0; count++) {
+            assert(ht_put(full, &count, &value));
+        }
+        size_t cap = full->arr_cap;
+        int key = 0;
+        for (; key < count; key++) {
+            ht_delete(full, &key);
+            if (full->growth_left == 0) {
+                break;
+            }
+            assert(ht_put(full, &key, &value));
+        }
+        assert(key < count);
+        assert(ht_put(full, &key, &value) && full->arr_cap == cap && full->growth_left == 0);
+        ht_destroy(full);
+    }
+
+    size_t old_cap = ht->arr_cap;
+    assert(ht_resize(ht, 4 * old_cap));
+    assert(ht->arr_cap > old_cap);
+    // no bucket count that large exists, the table is left as it was
+    old_cap = ht->arr_cap;
+    assert(!ht_resize(ht, SIZE_MAX) && ht->arr_cap == old_cap);
+    assert(!ht_reserve(ht, SIZE_MAX / 4) && ht->arr_cap == old_cap);
+    assert(!ht_reserve(ht, SIZE_MAX) && ht->arr_cap == old_cap);
+    for (int i = 1; i < 10000; i += 2) {
+        assert(ht_contains(ht, &i));
+    }
+
+    ht_clear(ht);
+    assert(ht_empty(ht));
+    for (int i = 0; i < 10000; i++) {
+        assert(!ht_contains(ht, &i));
+    }
+
+    printf("Passed: %s backend test\n", name);
+    ht_destroy(ht);
+}
+
+void test_incremental_rehash() {
+    printf("Running incremental rehash test...\n");
+    HTConfig config = { .backend = HT_CHAINED, .incremental_rehash = true };
+    Hashtable *ht = ht_create_with(int, int, &config);
+    assert(ht);
+
+    bool saw_rehash = false;
+    for (int i = 0; i < 50000; i++) {
+        assert(ht_put(ht, &i, &i));
+        saw_rehash |= ht->old_arr != NULL;
+        // keys inserted before the current migration must stay visible
+        int probe = i / 2;
+        int *found = ht_find(ht, &probe);
+        assert(found && *found == probe);
+    }
+    assert(saw_rehash);
+    assert(ht_count(ht) == 50000);
+
+    for (int i = 0; i < 50000; i += 3) {
+        ht_delete(ht, &i);
+    }
+    for (int i = 0; i < 50000; i++) {
+        int out = -1;
+        assert(ht_get(ht, &i, &out) == (i % 3 != 0));
+        if (i % 3 != 0) {
+            assert(out == i);
+        }
+    }
+
+    // an explicit resize completes any migration that is still running
+    assert(ht_resize(ht, 4 * ht->arr_cap));
+    assert(ht->old_arr == NULL);
+    for (int i = 1; i < 50000; i += 3) {
+        assert(ht_contains(ht, &i));
+    }
+
+    printf("Passed: Incremental rehash test\n");
+    ht_destroy(ht);
+}
+
+static uint64_t fnv1a(const void *key, size_t key_size) {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (size_t i = 0; i < key_size; i++) {
+        hash = (hash ^ ((const unsigned char *)key)[i]) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+static uint64_t constant_hash(const void *key, size_t key_size) {
+    return 42;
+}
+
+void test_hash_kinds() {
+    printf("Running hash kinds test...\n");
+    HTHashKind kinds[] = {HT_HASH_XXH3, HT_HASH_XXH32, HT_HASH_DJB2, HT_HASH_INT, HT_HASH_CUSTOM};
+    for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+        HTConfig config = { .hash = kinds[k], .hash_fn = fnv1a };
+        Hashtable *ht = ht_create_with(long, int, &config);
+        assert(ht);
+        for (long i = 0; i < 5000; i++) {
+            int value = (int)i;
+            assert(ht_put(ht, &i, &value));
+        }
+        for (long i = 0; i < 5000; i++) {
+            int *found = ht_find(ht, &i);
+            assert(found && *found == (int)i);
+        }
+        long key = 1234;
+        assert(ht_hash(ht, &key) == ht_hash(ht, &key));
+        ht_destroy(ht);
+    }
+
+    // more keys sharing a hash than a Robin Hood probe run holds make puts fail
+    // once growing stops helping, the keys already in stay reachable
+    HTConfig constant = { .backend = HT_ROBIN_HOOD, .hash = HT_HASH_CUSTOM, .hash_fn = constant_hash };
+    Hashtable *collided = ht_create_with(int, int, &constant);
+    assert(collided);
+    int placed = 0;
+    while (placed < 1000 && ht_put(collided, &placed, &placed)) {
+        placed++;
+    }
+    assert(placed > 0 && placed < 1000 && ht_count(collided) == (size_t)placed);
+    for (int i = 0; i < placed; i++) {
+        assert(ht_contains(collided, &i));
+    }
+    ht_destroy(collided);
+
+    Hashtable ht;
+    HTConfig missing_fn = { .hash = HT_HASH_CUSTOM };
+    assert(!ht_init_with(&ht, sizeof(int), sizeof(int), &missing_fn));
+    printf("Passed: Hash kinds test\n");
+}
+
+void test_batch_lookup(HTConfig config, const char *name) {
+    printf("Running %s batch lookup test...\n", name);
+    Hashtable *ht = ht_create_with(int, int, &config);
+    assert(ht);
+    for (int i = 0; i < 1000; i += 2) {
+        int value = i * 10;
+        assert(ht_put(ht, &i, &value));
+    }
+
+    // 1000 keys, the odd ones are missing, count not a multiple of the group size
+    int keys[1000];
+    for (int i = 0; i < 1000; i++) {
+        keys[i] = i;
+    }
+    void *found[1000];
+    assert(ht_find_batch(ht, keys, 1000, found) == 500);
+    for (int i = 0; i < 1000; i++) {
+        assert(found[i] == ht_find(ht, &keys[i]));
+    }
+
+    int values[1000];
+    bool present[1000];
+    memset(values, 0xFF, sizeof(values));
+    assert(ht_get_batch(ht, keys, 1000, values, present) == 500);
+    for (int i = 0; i < 1000; i++) {
+        assert(present[i] == (i % 2 == 0));
+        assert(present[i] ? values[i] == i * 10 : values[i] == -1);
+    }
+
+    memset(present, 0, sizeof(present));
+    assert(ht_contains_batch(ht, keys + 1, 999, present) == 499);
+    for (int i = 0; i < 999; i++) {
+        assert(present[i] == (i % 2 == 1));
+    }
+
+    printf("Passed: %s batch lookup test\n", name);
+    ht_destroy(ht);
+}
+
+void test_put_batch(HTConfig config, const char *name) {
+    printf("Running %s put batch test...\n", name);
+    Hashtable *ht = ht_create_with(int, int, &config);
+    assert(ht);
+    assert(ht_reserve(ht, 20000));
+    size_t reserved_cap = ht->arr_cap;
+
+    int keys[20000], values[20000];
+    for (int i = 0; i < 20000; i++) {
+        keys[i] = i % 15000; // the last 5000 keys overwrite earlier ones
+        values[i] = i;
+    }
+    assert(ht_put_batch(ht, keys, values, 20000));
+    assert(ht->arr_cap == reserved_cap);
+    assert(ht_count(ht) == 15000);
+    for (int i = 0; i < 15000; i++) {
+        int *found = ht_find(ht, &i);
+        assert(found && *found == (i < 5000 ? i + 15000 : i));
+    }
+
+    // batch loaded entries can be deleted, reused and cleared like any other
+    for (int i = 0; i < 15000; i += 2) {
+        ht_delete(ht, &i);
+    }
+    for (int i = 100000; i < 105000; i++) {
+        assert(ht_put(ht, &i, &i));
+    }
+    assert(ht_count(ht) == 12500);
+    for (int i = 1; i < 15000; i += 2) {
+        assert(ht_contains(ht, &i));
+    }
+    ht_clear(ht);
+    assert(ht_empty(ht));
+    assert(ht_put_batch(ht, keys, values, 100));
+    assert(ht_count(ht) == 100);
+
+    printf("Passed: %s put batch test\n", name);
+    ht_destroy(ht);
+}
+
+void test_slab_reuse() {
+    printf("Running slab reuse test...\n");
+    Hashtable *ht = ht_create(int, int);
+    for (int i = 0; i < 50000; i++) {
+        assert(ht_put(ht, &i, &i));
+    }
+    size_t chunk_bytes = ht->slab.chunk_bytes;
+    assert(chunk_bytes > 0);
+    // a run whose chunk size overflows fails without allocating
+    assert(!ht_slab_alloc_run(&ht->slab, SIZE_MAX / ht->slab.node_size + 1));
+    assert(ht->slab.chunk_bytes == chunk_bytes);
+
+    // deleted nodes are recycled and a cleared table refills the same chunks
+    for (int i = 0; i < 50000; i += 2) {
+        ht_delete(ht, &i);
+    }
+    for (int i = 100000; i < 125000; i++) {
+        assert(ht_put(ht, &i, &i));
+    }
+    assert(ht->slab.chunk_bytes == chunk_bytes);
+    ht_clear(ht);
+    for (int round = 0; round < 3; round++) {
+        for (int i = 0; i < 50000; i++) {
+            assert(ht_put(ht, &i, &i));
+        }
+        ht_clear(ht);
+    }
+    assert(ht->slab.chunk_bytes == chunk_bytes);
+    for (int i = 0; i < 50000; i++) {
+        assert(ht_put(ht, &i, &i));
+    }
+    for (int i = 0; i < 50000; i++) {
+        int *found = ht_find(ht, &i);
+        assert(found && *found == i);
+    }
+
+    printf("Passed: Slab reuse test\n");
+    ht_destroy(ht);
+}
+
+void test_stats(HTConfig config, const char *name) {
+    printf("Running %s stats test...\n", name);
+    Hashtable *ht = ht_create_with(int, int, &config);
+    for (int i = 0; i < 10000; i++) {
+        assert(ht_put(ht, &i, &i));
+    }
+    for (int i = 0; i < 20000; i++) {
+        ht_find(ht, &i);
+    }
+
+    HTStats stats;
+    ht_stats(ht, &stats);
+    assert(stats.count == 10000);
+    assert(stats.capacity == ht->arr_cap);
+    assert(stats.load_factor > 0.0 && stats.load_factor <= 1.0);
+    assert(stats.empty_ratio >= 0.0 && stats.empty_ratio < 1.0);
+    assert(stats.max_chain >= 1 && stats.mean_chain >= 1.0);
+    assert(stats.mean_chain <= stats.max_chain);
+    assert(stats.bucket_bytes > 0);
+    assert((config.backend == HT_CHAINED) == (stats.node_bytes > 0));
+    size_t hist_total = 0;
+    for (int i = 0; i < HT_STATS_HIST_LEN; i++) {
+        hist_total += stats.chain_hist[i];
+    }
+    // chained tables count buckets, open addressing ones count entries
+    assert(hist_total == (config.backend == HT_CHAINED ? ht->arr_cap : 10000));
+
+#ifdef HT_STATS
+    assert(stats.counters.resizes > 0);
+    assert(stats.counters.hash_calls >= 30000);
+    assert(stats.counters.lookups >= 30000);
+    assert(stats.probes_per_lookup > 0.0);
+#else
+    assert(stats.counters.lookups == 0 && stats.counters.hash_calls == 0);
+#endif
+
+    ht_clear(ht);
+    ht_stats(ht, &stats);
+    assert(stats.count == 0 && stats.max_chain == 0 && stats.empty_ratio == 1.0);
+
+    printf("Passed: %s stats test\n", name);
+    ht_destroy(ht);
+}
+
+#define CONCURRENT_THREADS 8
+#define CONCURRENT_KEYS 20000 // per thread
+
+typedef struct ConcurrentArg {
+    HTConcurrent *ct;
+    int thread;
+} ConcurrentArg;
+
+// each thread owns a disjoint key range, puts it while the table keeps growing
+// under the other threads, reads it back, then deletes the even keys
+static void *concurrent_worker(void *p) {
+    ConcurrentArg *arg = p;
+    int base = arg->thread * CONCURRENT_KEYS;
+    for (int i = base; i < base + CONCURRENT_KEYS; i++) {
+        int value = i * 2;
+        assert(ht_concurrent_put(arg->ct, &i, &value));
+    }
+    for (int i = base; i < base + CONCURRENT_KEYS; i++) {
+        int value = -1;
+        assert(ht_concurrent_get(arg->ct, &i, &value) && value == i * 2);
+    }
+    for (int i = base; i < base + CONCURRENT_KEYS; i += 2) {
+        assert(ht_concurrent_delete(arg->ct, &i));
+    }
+    return NULL;
+}
+
+void test_concurrent() {
+    printf("Running concurrent test...\n");
+    HTConcurrent *ct = ht_concurrent_create(int, int, 16);
+    assert(ct);
+    pthread_t threads[CONCURRENT_THREADS];
+    ConcurrentArg args[CONCURRENT_THREADS];
+    for (int t = 0; t < CONCURRENT_THREADS; t++) {
+        args[t] = (ConcurrentArg){ .ct = ct, .thread = t };
+        assert(pthread_create(&threads[t], NULL, concurrent_worker, &args[t]) == 0);
+    }
+    for (int t = 0; t < CONCURRENT_THREADS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    assert(ht_concurrent_count(ct) == CONCURRENT_THREADS * CONCURRENT_KEYS / 2);
+    assert(ct->table.arr_cap >= ht_concurrent_count(ct));
+    for (int i = 0; i < CONCURRENT_THREADS * CONCURRENT_KEYS; i++) {
+        assert(ht_concurrent_contains(ct, &i) == (i % 2 == 1));
+    }
+    assert(!ht_concurrent_delete(ct, &(int){0}));
+
+    ht_concurrent_clear(ct);
+    assert(ht_concurrent_count(ct) == 0);
+    int key = 7, value = 70;
+    assert(ht_concurrent_put(ct, &key, &value));
+    assert(ht_concurrent_get(ct, &key, &value) && value == 70);
+
+    printf("Passed: Concurrent test\n");
+    ht_concurrent_destroy(ct);
+}
+
+typedef struct EpochArg {
+    HTConcurrent *ct;
+    int thread;
+    _Atomic bool *stop;
+} EpochArg;
+
+// readers never lock, every value they copy out has to be whole, 3 * key
+static void *epoch_reader(void *p) {
+    EpochArg *arg = p;
+    long found = 0;
+    while (!atomic_load(arg->stop)) {
+        for (int i = 0; i < 4 * CONCURRENT_KEYS; i += 7) {
+            long value[4];
+            if (ht_concurrent_get(arg->ct, &i, value)) {
+                assert(value[0] == i * 3L && value[3] == i * 3L);
+                found++;
+            }
+        }
+    }
+    return (void *)found;
+}
+
+// writers grow the table, rewrite values in place of the old nodes and delete
+static void *epoch_writer(void *p) {
+    EpochArg *arg = p;
+    int base = arg->thread * CONCURRENT_KEYS;
+    for (int round = 0; round < 3; round++) {
+        for (int i = base; i < base + CONCURRENT_KEYS; i++) {
+            long value[4] = {i * 3L, i * 3L, i * 3L, i * 3L};
+            assert(ht_concurrent_put(arg->ct, &i, value));
+        }
+        for (int i = base + round % 2; i < base + CONCURRENT_KEYS; i += 2) {
+            assert(ht_concurrent_delete(arg->ct, &i));
+        }
+    }
+    return NULL;
+}
+
+void test_concurrent_epoch() {
+    printf("Running concurrent epoch test...\n");
+    HTConcurrentConfig config = { .stripes = 8, .read_mode = HT_READ_EPOCH };
+    HTConcurrent *ct = _ht_concurrent_create_with(sizeof(int), 4 * sizeof(long), &config);
+    assert(ct);
+    _Atomic bool stop = false;
+    pthread_t readers[4], writers[4];
+    EpochArg args[4];
+    for (int t = 0; t < 4; t++) {
+        args[t] = (EpochArg){ .ct = ct, .thread = t, .stop = &stop };
+        assert(pthread_create(&readers[t], NULL, epoch_reader, &args[t]) == 0);
+        assert(pthread_create(&writers[t], NULL, epoch_writer, &args[t]) == 0);
+    }
+    for (int t = 0; t < 4; t++) {
+        pthread_join(writers[t], NULL);
+    }
+    atomic_store(&stop, true);
+    for (int t = 0; t < 4; t++) {
+        pthread_join(readers[t], NULL);
+    }
+
+    // the last round deletes the even keys of every range
+    assert(ht_concurrent_count(ct) == 4 * CONCURRENT_KEYS / 2);
+    for (int i = 0; i < 4 * CONCURRENT_KEYS; i++) {
+        assert(ht_concurrent_contains(ct, &i) == (i % 2 == 1));
+    }
+    assert(ht_concurrent_resize(ct, 4 * ct->table.arr_cap));
+    long value[4];
+    assert(ht_concurrent_get(ct, &(int){1}, value) && value[0] == 3);
+    ht_concurrent_clear(ct);
+    assert(ht_concurrent_count(ct) == 0 && !ht_concurrent_contains(ct, &(int){1}));
+
+    printf("Passed: Concurrent epoch test\n");
+    ht_concurrent_destroy(ct);
+}
+
+typedef struct ShardedArg {
+    HTSharded *sh;
+    int thread;
+} ShardedArg;
+
+static void *sharded_worker(void *p) {
+    ShardedArg *arg = p;
+    int base = arg->thread * CONCURRENT_KEYS;
+    for (int i = base; i < base + CONCURRENT_KEYS; i++) {
+        int value = i + 1;
+        assert(ht_sharded_put(arg->sh, &i, &value));
+    }
+    for (int i = base; i < base + CONCURRENT_KEYS; i += 2) {
+        assert(ht_sharded_delete(arg->sh, &i));
+    }
+    return NULL;
+}
+
+void test_sharded(HTConfig config, const char *name) {
+    printf("Running %s sharded test...\n", name);
+    HTSharded *sh = ht_sharded_create(int, int, 8, &config);
+    assert(sh && sh->shard_count == 8);
+    pthread_t threads[CONCURRENT_THREADS];
+    ShardedArg args[CONCURRENT_THREADS];
+    for (int t = 0; t < CONCURRENT_THREADS; t++) {
+        args[t] = (ShardedArg){ .sh = sh, .thread = t };
+        assert(pthread_create(&threads[t], NULL, sharded_worker, &args[t]) == 0);
+    }
+    for (int t = 0; t < CONCURRENT_THREADS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    size_t total = CONCURRENT_THREADS * CONCURRENT_KEYS;
+    assert(ht_sharded_count(sh) == total / 2);
+    for (int i = 0; i < (int)total; i++) {
+        int value = 0;
+        assert(ht_sharded_get(sh, &i, &value) == (i % 2 == 1));
+        assert(i % 2 == 0 || value == i + 1);
+    }
+    // every shard grew on its own and holds a fair share of the keys
+    for (size_t i = 0; i < sh->shard_count; i++) {
+        size_t count = ht_count(&sh->shards[i].table);
+        assert(count > total / 2 / sh->shard_count / 2);
+        assert(count < total / 2 / sh->shard_count * 2);
+    }
+    assert(!ht_sharded_delete(sh, &(int){0}));
+
+    ht_sharded_clear(sh);
+    assert(ht_sharded_count(sh) == 0 && !ht_sharded_contains(sh, &(int){1}));
+    assert(!ht_sharded_delete(sh, &(int){1}));
+
+    printf("Passed: %s sharded test\n", name);
+    ht_sharded_destroy(sh);
+}
+
+static void sum_entry(void *key, void *value, void *ctx) {
+    long *sums = ctx;
+    sums[0] += *(int *)key;
+    sums[1] += *(int *)value;
+    sums[2]++;
+}
+
+void test_iterator(HTConfig config, const char *name) {
+    printf("Running %s iterator test...\n", name);
+    Hashtable *ht = ht_create_with(int, int, &config);
+    HTIterator iter;
+    HTEntry entry;
+    assert(ht_iterator_init(&iter, ht));
+    assert(!ht_iterator_next(&iter, &entry));
+
+    long key_sum = 0;
+    for (int i = 0; i < 5000; i++) {
+        int value = i * 3;
+        assert(ht_put(ht, &i, &value));
+        key_sum += i;
+    }
+    // holes left by deletes are skipped
+    for (int i = 0; i < 5000; i += 5) {
+        ht_delete(ht, &i);
+        key_sum -= i;
+    }
+
+    HTIterator *it = ht_iterator_create(ht);
+    assert(it);
+    for (int pass = 0; pass < 2; pass++) {
+        long keys = 0, seen = 0;
+        while (ht_iterator_next(it, &entry)) {
+            int key = *(int *)entry.key;
+            assert(key % 5 != 0);
+            assert(*(int *)entry.value == key * 3);
+            assert(entry.value == ht_find(ht, &key));
+            keys += key;
+            seen++;
+        }
+        assert(seen == (long)ht_count(ht) && keys == key_sum);
+        ht_iterator_restart(it);
+    }
+    ht_iterator_destroy(it);
+    assert(it == NULL);
+
+    long sums[3] = {0, 0, 0};
+    ht_foreach(ht, sum_entry, sums);
+    assert(sums[0] == key_sum && sums[1] == key_sum * 3 && sums[2] == (long)ht_count(ht));
+
+    printf("Passed: %s iterator test\n", name);
+    ht_destroy(ht);
+}
+
+typedef struct ScanAcc {
+    long key_sum;
+    long count;
+    int max_value;
+} ScanAcc;
+
+static void count_entry(void *key, void *value, void *ctx) {
+    atomic_fetch_add((_Atomic long *)ctx, *(int *)key);
+}
+
+static void reduce_entry(void *key, void *value, void *acc, void *ctx) {
+    ScanAcc *a = acc;
+    a->key_sum += *(int *)key;
+    a->count++;
+    a->max_value = *(int *)value > a->max_value ? *(int *)value : a->max_value;
+}
+
+static void combine_acc(void *out_acc, const void *worker_acc, void *ctx) {
+    ScanAcc *out = out_acc;
+    const ScanAcc *w = worker_acc;
+    out->key_sum += w->key_sum;
+    out->count += w->count;
+    out->max_value = w->max_value > out->max_value ? w->max_value : out->max_value;
+    (*(int *)ctx)++;
+}
+
+void test_parallel_scan(HTConfig config, const char *name) {
+    printf("Running %s parallel scan test...\n", name);
+    Hashtable *ht = ht_create_with(int, int, &config);
+    long key_sum = 0;
+    for (int i = 0; i < 30000; i++) {
+        int value = i % 1000;
+        assert(ht_put(ht, &i, &value));
+        key_sum += i;
+    }
+
+    size_t thread_counts[] = {0, 1, 3, 8};
+    for (int t = 0; t < 4; t++) {
+        _Atomic long sum = 0;
+        ht_parallel_foreach(ht, count_entry, &sum, thread_counts[t]);
+        assert(sum == key_sum);
+
+        ScanAcc init = { .max_value = -1 }, out;
+        int combines = 0;
+        assert(ht_parallel_reduce(ht, thread_counts[t], &init, sizeof(ScanAcc), reduce_entry, combine_acc, &combines, &out));
+        assert(out.key_sum == key_sum && out.count == 30000 && out.max_value == 999);
+        assert(combines >= 1 && (thread_counts[t] == 0 || combines == (int)thread_counts[t]));
+    }
+
+    printf("Passed: %s parallel scan test\n", name);
+    ht_destroy(ht);
+}
+
+void test_snapshot(HTConfig config, const char *name) {
+    printf("Running %s snapshot test...\n", name);
+    const char *path = "ht_tests_snapshot.bin";
+    Hashtable *ht = ht_create_with(int, long, &config);
+    for (int i = 0; i < 20000; i++) {
+        long value = (long)i * 7;
+        assert(ht_put(ht, &i, &value));
+    }
+    for (int i = 0; i < 20000; i += 3) {
+        ht_delete(ht, &i);
+    }
+    assert(ht_save(ht, path));
+
+    Hashtable *loaded = ht_load(path);
+    assert(loaded);
+    assert(loaded->backend == ht->backend && loaded->hash_kind == ht->hash_kind);
+    assert(ht_count(loaded) == ht_count(ht));
+    for (int i = 0; i < 20000; i++) {
+        long value;
+        if (i % 3 == 0) {
+            assert(!ht_contains(loaded, &i));
+        } else {
+            assert(ht_get(loaded, &i, &value) && value == (long)i * 7);
+        }
+    }
+    // the loaded table stays usable
+    int key = 20000;
+    long value = 1;
+    assert(ht_put(loaded, &key, &value) && ht_count(loaded) == ht_count(ht) + 1);
+    ht_destroy(loaded);
+
+    // the cached hashes don't depend on the backend
+    HTConfig other = { .backend = config.backend == HT_CHAINED ? HT_SWISS : HT_CHAINED };
+    loaded = ht_load_with(path, &other);
+    assert(loaded && loaded->backend == other.backend && ht_count(loaded) == ht_count(ht));
+    key = 20000 - 1;
+    assert(ht_get(loaded, &key, &value) && value == (long)key * 7);
+    ht_destroy(loaded);
+
+    HTConfig wrong_hash = { .backend = config.backend, .hash = HT_HASH_DJB2 };
+    assert(ht_load_with(path, &wrong_hash) == NULL);
+
+    // headers with enums out of range or more entries than the file holds are rejected
+    uint32_t bad_enums[][2] = { { 16, 99 }, { 20, 99 }, { 12, 99 } }; // backend, cap_policy, hash_kind
+    for (int i = 0; i < 3; i++) {
+        assert(ht_save(ht, path));
+        FILE *file = fopen(path, "r+b");
+        assert(file);
+        fseek(file, bad_enums[i][0], SEEK_SET);
+        assert(fwrite(&bad_enums[i][1], sizeof(uint32_t), 1, file) == 1);
+        fclose(file);
+        assert(ht_load(path) == NULL);
+    }
+    assert(ht_save(ht, path));
+    FILE *file = fopen(path, "r+b");
+    assert(file);
+    uint64_t count = (uint64_t)1 << 60;
+    fseek(file, 40, SEEK_SET);
+    assert(fwrite(&count, sizeof(count), 1, file) == 1);
+    fclose(file);
+    assert(ht_load(path) == NULL);
+
+    // as is a cut off snapshot
+    assert(ht_save(ht, path));
+    file = fopen(path, "r+b");
+    assert(file);
+    fseek(file, 0, SEEK_END);
+    assert(ftruncate(fileno(file), ftell(file) / 2) == 0);
+    fclose(file);
+    assert(ht_load(path) == NULL);
+
+    // so are headers claiming variable length or oversized records
+    uint64_t bad_sizes[][2] = { { HT_VARLEN_KEY, sizeof(long) }, { 1 << 21, sizeof(long) }, { sizeof(int), UINT64_MAX } };
+    for (int i = 0; i < 3; i++) {
+        file = fopen(path, "r+b");
+        assert(file);
+        fseek(file, 24, SEEK_SET); // key_size and value_size follow magic, version and three enums
+        assert(fwrite(bad_sizes[i], sizeof(uint64_t), 2, file) == 2);
+        fclose(file);
+        assert(ht_load(path) == NULL);
+    }
+    remove(path);
+    assert(ht_load(path) == NULL);
+    Hashtable *huge = _ht_create_with(sizeof(int), 1 << 21, &config);
+    assert(huge && !ht_save(huge, path));
+    ht_destroy(huge);
+
+    printf("Passed: %s snapshot test\n", name);
+    ht_destroy(ht);
+}
+
+static uint64_t mod_hash(const void *key, size_t key_size) {
+    return (uint64_t)(*(const int *)key % 1000 + 1) * 0x9E3779B97F4A7C15ull;
+}
+
+void test_frozen(HTConfig config, const char *name) {
+    printf("Running %s frozen table test...\n", name);
+    const char *path = "ht_tests_frozen.bin";
+    Hashtable *ht = ht_create_with(int, double, &config);
+    for (int i = 0; i < 20000; i++) {
+        double value = i * 0.5;
+        assert(ht_put(ht, &i, &value));
+    }
+    for (int i = 0; i < 20000; i += 4) {
+        ht_delete(ht, &i);
+    }
+    assert(ht_freeze(ht, path));
+
+    HTFrozen fz, other;
+    assert(ht_frozen_open(&fz, path, NULL));
+    assert(ht_frozen_open(&other, path, NULL));
+    assert(ht_frozen_count(&fz) == ht_count(ht));
+    for (int i = -10; i < 20010; i++) {
+        double value;
+        if (i < 0 || i >= 20000 || i % 4 == 0) {
+            assert(!ht_frozen_contains(&fz, &i));
+            continue;
+        }
+        const double *found = ht_frozen_find(&fz, &i);
+        // values sit inside the mapping, aligned for their type
+        assert(found && *found == i * 0.5 && (uintptr_t)found % _Alignof(double) == 0);
+        assert((const unsigned char *)found >= fz.map && (const unsigned char *)found < fz.map + fz.map_size);
+        assert(ht_frozen_get(&other, &i, &value) && value == i * 0.5);
+    }
+    ht_frozen_close(&other);
+    ht_frozen_close(&fz);
+    assert(fz.map == NULL);
+
+    // an empty table freezes too
+    ht_clear(ht);
+    assert(ht_freeze(ht, path));
+    assert(ht_frozen_open(&fz, path, NULL));
+    int key = 1;
+    assert(ht_frozen_count(&fz) == 0 && !ht_frozen_contains(&fz, &key));
+    ht_frozen_close(&fz);
+    ht_destroy(ht);
+
+    // colliding hashes share a bucket run, custom hashes need the function again
+    HTConfig custom = { .backend = config.backend, .hash = HT_HASH_CUSTOM, .hash_fn = mod_hash };
+    ht = ht_create_with(int, int, &custom);
+    for (int i = 0; i < 5000; i++) {
+        assert(ht_put(ht, &i, &i));
+    }
+    assert(ht_freeze(ht, path));
+    assert(!ht_frozen_open(&fz, path, NULL));
+    assert(ht_frozen_open(&fz, path, mod_hash));
+    for (int i = 0; i < 5000; i++) {
+        int value;
+        assert(ht_frozen_get(&fz, &i, &value) && value == i);
+    }
+    ht_frozen_close(&fz);
+
+    // a snapshot is not a frozen image
+    assert(ht_save(ht, path));
+    assert(!ht_frozen_open(&fz, path, NULL));
+    ht_destroy(ht);
+    remove(path);
+    assert(!ht_frozen_open(&fz, path, NULL));
+    printf("Passed: %s frozen table test\n", name);
+}
+
+void test_perfect(HTConfig config, const char *name) {
+    printf("Running %s perfect hash test...\n", name);
+    Hashtable *ht = ht_create_with(int, long, &config);
+    for (int i = 0; i < 50000; i++) {
+        long value = (long)i * 11;
+        assert(ht_put(ht, &i, &value));
+    }
+    HTPerfect *ph = ht_perfect_create(ht);
+    assert(ph && ht_perfect_count(ph) == 50000);
+    for (int i = -100; i < 50100; i++) {
+        long value;
+        if (i < 0 || i >= 50000) {
+            assert(!ht_perfect_contains(ph, &i) && ht_perfect_find(ph, &i) == NULL);
+            continue;
+        }
+        const long *found = ht_perfect_find(ph, &i);
+        assert(found && *found == (long)i * 11);
+        assert(ht_perfect_get(ph, &i, &value) && value == (long)i * 11);
+    }
+    assert(ht_perfect_bits_per_key(ph) < 4.0);
+    ht_perfect_destroy(ph);
+    assert(ph == NULL);
+    ht_destroy(ht);
+
+    // the 1000 dictionary keys of test_cases.h
+    ht = _ht_create_with(16, sizeof(int), &config);
+    for (int i = 0; i < 1000; i++) {
+        assert(ht_put(ht, test_cases[i], &i));
+    }
+    HTPerfect dict;
+    assert(ht_perfect_init(&dict, ht));
+    for (int i = 0; i < 1000; i++) {
+        int value;
+        assert(ht_perfect_get(&dict, test_cases[i], &value) && value == i);
+    }
+    assert(!ht_perfect_contains(&dict, "not-a-key-000000"));
+    ht_perfect_deinit(&dict);
+
+    ht_clear(ht);
+    assert(ht_perfect_init(&dict, ht));
+    assert(ht_perfect_count(&dict) == 0 && !ht_perfect_contains(&dict, test_cases[0]));
+    ht_perfect_deinit(&dict);
+    ht_destroy(ht);
+
+    // no pilot separates two keys with one hash
+    HTConfig same_hash = { .backend = config.backend, .hash = HT_HASH_CUSTOM, .hash_fn = constant_hash };
+    ht = ht_create_with(int, int, &same_hash);
+    for (int i = 0; i < 2; i++) {
+        assert(ht_put(ht, &i, &i));
+    }
+    assert(!ht_perfect_init(&dict, ht));
+    ht_destroy(ht);
+
+    printf("Passed: %s perfect hash test\n", name);
+}
+
+static void unexpected_upsert(void *value, bool inserted, void *ctx) {
+    assert(!"ht_upsert called fn on a table it should refuse");
+}
+
+void test_varlen_keys(HTConfig config, const char *name) {
+    printf("Running %s variable length key test...\n", name);
+    Hashtable *ht = _ht_create_with(HT_VARLEN_KEY, sizeof(int), &config);
+    assert(ht);
+    for (int i = 0; i < 1000; i++) {
+        assert(ht_put_str(ht, test_cases[i], &i));
+    }
+    // the text is hashed, not the pointer, so a copy of a key finds its entry
+    char copy[17];
+    memcpy(copy, test_cases[7], sizeof(copy));
+    int value;
+    assert(ht_get_str(ht, copy, &value) && value == 7);
+    copy[15] = '#';
+    assert(!ht_contains_str(ht, copy));
+    // prefixes and extensions of a key are other keys
+    copy[15] = '\0';
+    assert(!ht_contains_str(ht, copy));
+
+    char long_key[3000];
+    memset(long_key, 'x', sizeof(long_key) - 1);
+    long_key[sizeof(long_key) - 1] = '\0';
+    int long_value = -1, empty_value = -2, embedded_value = -3;
+    assert(ht_put_str(ht, long_key, &long_value));
+    assert(ht_put_str(ht, "", &empty_value));
+    assert(ht_put_bytes(ht, "a\0b", 3, &embedded_value));
+    assert(ht_count(ht) == 1003);
+    assert(*(int *)ht_find_str(ht, long_key) == -1);
+    assert(*(int *)ht_find_str(ht, "") == -2);
+    assert(*(int *)ht_find_bytes(ht, "a\0b", 3) == -3 && !ht_contains_str(ht, "a"));
+
+    int updated = 99;
+    assert(ht_put_str(ht, test_cases[3], &updated) && ht_count(ht) == 1003);
+    assert(ht_get_str(ht, test_cases[3], &value) && value == 99);
+    bool inserted;
+    int *slot = ht_get_or_insert_str(ht, test_cases[3], &inserted);
+    assert(slot && !inserted && *slot == 99);
+    slot = ht_get_or_insert_bytes(ht, long_key, 40, &inserted);
+    assert(slot && inserted && *slot == 0 && ht_count(ht) == 1004);
+    assert(ht_delete_bytes(ht, long_key, 40));
+
+    // the fixed key entry points refuse the table instead of hashing 0 bytes
+    int four = 4;
+    void *found_value;
+    bool found_flag;
+    assert(!ht_put(ht, &four, &four) && !ht_find(ht, &four) && !ht_get(ht, &four, &value));
+    assert(!ht_get_or_insert(ht, &four, NULL) && !ht_upsert(ht, &four, unexpected_upsert, NULL));
+    assert(!ht_put_batch(ht, &four, &four, 1) && ht_find_batch(ht, &four, 1, &found_value) == 0);
+    assert(ht_get_batch(ht, &four, 1, &value, NULL) == 0 && ht_contains_batch(ht, &four, 1, &found_flag) == 0);
+    ht_delete(ht, &four);
+    assert(ht_count(ht) == 1003);
+
+    // iterated keys carry their length and a NUL
+    HTIterator iter;
+    HTEntry entry;
+    size_t seen = 0, key_bytes = 0;
+    ht_iterator_init(&iter, ht);
+    while (ht_iterator_next(&iter, &entry)) {
+        size_t len = ht_key_len(ht, entry.key);
+        assert(((char *)entry.key)[len] == '\0');
+        assert(ht_find_bytes(ht, entry.key, len) == entry.value);
+        key_bytes += len;
+        seen++;
+    }
+    size_t expected_bytes = sizeof(long_key) - 1 + 3;
+    for (int i = 0; i < 1000; i++) {
+        expected_bytes += strlen(test_cases[i]);
+    }
+    assert(seen == 1003 && key_bytes == expected_bytes);
+
+    for (int i = 0; i < 1000; i += 2) {
+        assert(ht_delete_str(ht, test_cases[i]));
+    }
+    assert(!ht_delete_str(ht, test_cases[0]));
+    assert(ht_delete_str(ht, long_key) && ht_count(ht) == 502);
+    for (int i = 1; i < 1000; i += 2) {
+        assert(ht_get_str(ht, test_cases[i], &value) && value == (i == 3 ? 99 : i));
+    }
+    HTStats stats;
+    ht_stats(ht, &stats);
+    assert(stats.count == 502 && stats.node_bytes > 502 * 16);
+
+    ht_clear(ht);
+    assert(ht_empty(ht) && !ht_contains_str(ht, test_cases[1]));
+    assert(ht_put_str(ht, test_cases[1], &updated));
+    printf("Passed: %s variable length key test\n", name);
+    ht_destroy(ht);
+}
+
+typedef struct Tally {
+    int count;
+    int first_seen;
+} Tally;
+
+static void tally_upsert(void *value, bool inserted, void *ctx) {
+    Tally *tally = value;
+    if (inserted) {
+        assert(tally->count == 0);
+        tally->first_seen = *(int *)ctx;
+    }
+    tally->count++;
+}
+
+void test_get_or_insert(HTConfig config, const char *name) {
+    printf("Running %s get or insert test...\n", name);
+    Hashtable *ht = ht_create_with(int, Tally, &config);
+    assert(ht);
+    // key k is seen k % 5 + 1 times
+    int inserts = 0;
+    for (int round = 0; round < 5; round++) {
+        for (int key = 0; key < 20000; key++) {
+            if (key % 5 < round) {
+                continue;
+            }
+            bool inserted;
+            Tally *tally = ht_get_or_insert(ht, &key, &inserted);
+            assert(tally);
+            if (inserted) {
+                assert(tally->count == 0 && tally->first_seen == 0);
+                tally->first_seen = round;
+                inserts++;
+            }
+            tally->count++;
+        }
+    }
+    assert(inserts == 20000 && ht_count(ht) == 20000);
+    for (int key = 0; key < 20000; key++) {
+        Tally tally;
+        assert(ht_get(ht, &key, &tally) && tally.count == key % 5 + 1 && tally.first_seen == 0);
+    }
+    // slots of deleted keys come back zeroed
+    for (int key = 0; key < 20000; key += 2) {
+        ht_delete(ht, &key);
+    }
+    int key = 4;
+    assert(((Tally *)ht_get_or_insert(ht, &key, NULL))->count == 0 && ht_count(ht) == 10001);
+
+    for (int i = 0; i < 30000; i++) {
+        int k = i % 15000;
+        assert(ht_upsert(ht, &k, tally_upsert, &i));
+    }
+    for (int k = 0; k < 15000; k++) {
+        Tally tally;
+        assert(ht_get(ht, &k, &tally));
+        // odd keys and 4 were present, the other even keys were inserted at i == k
+        assert(tally.count == (k % 2 ? k % 5 + 3 : 2));
+        assert(tally.first_seen == (k % 2 || k == 4 ? 0 : k));
+    }
+    ht_destroy(ht);
+    printf("Passed: %s get or insert test\n", name);
+}
+
+HT_DEFINE(IntLongMap, int, long, HT_HASH_INTEGER, HT_EQ_SCALAR)
+
+typedef struct Point {
+    int x, y;
+} Point;
+
+#define point_hash(p) ht_mix64(((uint64_t)(uint32_t)(p).x << 32) | (uint32_t)(p).y)
+#define point_eq(a, b) ((a).x == (b).x && (a).y == (b).y)
+HT_DEFINE(PointMap, Point, double, point_hash, point_eq)
+
+// case blind keys, equal keys may differ in their bytes
+typedef struct Code {
+    char c[4];
+} Code;
+
+static uint64_t code_hash(Code code) {
+    uint32_t folded = 0;
+    for (int i = 0; i < 4; i++) {
+        folded = folded << 8 | (uint8_t)(code.c[i] | 0x20);
+    }
+    return ht_mix64(folded);
+}
+
+static bool code_eq(Code a, Code b) {
+    for (int i = 0; i < 4; i++) {
+        if ((a.c[i] | 0x20) != (b.c[i] | 0x20)) {
+            return false;
+        }
+    }
+    return true;
+}
+HT_DEFINE(CodeMap, Code, int, code_hash, code_eq)
+
+void test_specialized() {
+    printf("Running specialized table test...\n");
+    IntLongMap ints;
+    assert(IntLongMap_init(&ints));
+    for (int i = -5000; i < 5000; i++) {
+        assert(IntLongMap_put(&ints, i, (long)i * 3));
+    }
+    assert(IntLongMap_count(&ints) == 10000);
+    assert(IntLongMap_put(&ints, 7, 70) && IntLongMap_count(&ints) == 10000);
+    for (int i = -5000; i < 5000; i++) {
+        long value;
+        assert(IntLongMap_get(&ints, i, &value) && value == (i == 7 ? 70 : (long)i * 3));
+    }
+    assert(!IntLongMap_contains(&ints, 5000));
+    *IntLongMap_find(&ints, 8) += 1;
+    assert(*IntLongMap_find(&ints, 8) == 25);
+    for (int i = -5000; i < 5000; i += 2) {
+        assert(IntLongMap_delete(&ints, i));
+    }
+    assert(!IntLongMap_delete(&ints, -5000) && IntLongMap_count(&ints) == 5000);
+
+    // the embedded table is an ordinary chained table
+    int key = 9;
+    assert(ht_count(&ints.ht) == 5000 && *(long *)ht_find(&ints.ht, &key) == 27);
+    long sums[3] = {0, 0, 0};
+    ht_foreach(&ints.ht, sum_entry, sums);
+    assert(sums[2] == 5000);
+    ht_clear(&ints.ht);
+    assert(IntLongMap_count(&ints) == 0 && !IntLongMap_contains(&ints, 9));
+    IntLongMap_deinit(&ints);
+
+    PointMap points;
+    assert(PointMap_init(&points));
+    for (int x = 0; x < 100; x++) {
+        for (int y = 0; y < 100; y++) {
+            assert(PointMap_put(&points, (Point){ x, y }, x * 0.5 + y));
+        }
+    }
+    double d;
+    assert(PointMap_get(&points, (Point){ 42, 17 }, &d) && d == 38.0);
+    assert(!PointMap_contains(&points, (Point){ 17, 100 }));
+    PointMap_deinit(&points);
+
+    CodeMap codes;
+    assert(CodeMap_init(&codes));
+    assert(CodeMap_put(&codes, (Code){ "abcd" }, 1));
+    assert(CodeMap_put(&codes, (Code){ "ABCD" }, 2) && CodeMap_count(&codes) == 1);
+    assert(*CodeMap_find(&codes, (Code){ "aBcD" }) == 2);
+    assert(CodeMap_delete(&codes, (Code){ "Abcd" }) && CodeMap_count(&codes) == 0);
+    CodeMap_deinit(&codes);
+    printf("Passed: specialized table test\n");
+}
+
 int main() {
     printf("Starting hashtable tests...\n");
 
@@ -200,6 +1305,54 @@ int main() {
     test_clear();
     test_ht_get();
     test_ht_stack();
+    test_backend((HTConfig){ .backend = HT_CHAINED }, "chained");
+    test_backend((HTConfig){ .backend = HT_CHAINED, .cap_policy = HT_CAP_POW2 }, "chained power of two");
+    test_backend((HTConfig){ .backend = HT_SWISS }, "swiss");
+    test_backend((HTConfig){ .backend = HT_ROBIN_HOOD }, "robin hood");
+    test_incremental_rehash();
+    test_hash_kinds();
+    test_batch_lookup((HTConfig){ .backend = HT_CHAINED }, "chained");
+    test_batch_lookup((HTConfig){ .backend = HT_SWISS }, "swiss");
+    test_batch_lookup((HTConfig){ .backend = HT_ROBIN_HOOD }, "robin hood");
+    test_put_batch((HTConfig){ .backend = HT_CHAINED }, "chained");
+    test_put_batch((HTConfig){ .backend = HT_CHAINED, .incremental_rehash = true }, "incremental chained");
+    test_put_batch((HTConfig){ .backend = HT_SWISS }, "swiss");
+    test_put_batch((HTConfig){ .backend = HT_ROBIN_HOOD }, "robin hood");
+    test_slab_reuse();
+    test_stats((HTConfig){ .backend = HT_CHAINED }, "chained");
+    test_stats((HTConfig){ .backend = HT_SWISS }, "swiss");
+    test_stats((HTConfig){ .backend = HT_ROBIN_HOOD }, "robin hood");
+    test_concurrent();
+    test_concurrent_epoch();
+    test_sharded((HTConfig){ .backend = HT_CHAINED }, "chained");
+    test_sharded((HTConfig){ .backend = HT_SWISS }, "swiss");
+    test_sharded((HTConfig){ .backend = HT_ROBIN_HOOD }, "robin hood");
+    test_iterator((HTConfig){ .backend = HT_CHAINED }, "chained");
+    test_iterator((HTConfig){ .backend = HT_CHAINED, .incremental_rehash = true }, "incremental chained");
+    test_iterator((HTConfig){ .backend = HT_SWISS }, "swiss");
+    test_iterator((HTConfig){ .backend = HT_ROBIN_HOOD }, "robin hood");
+    test_parallel_scan((HTConfig){ .backend = HT_CHAINED }, "chained");
+    test_parallel_scan((HTConfig){ .backend = HT_CHAINED, .incremental_rehash = true }, "incremental chained");
+    test_parallel_scan((HTConfig){ .backend = HT_SWISS }, "swiss");
+    test_parallel_scan((HTConfig){ .backend = HT_ROBIN_HOOD }, "robin hood");
+    test_snapshot((HTConfig){ .backend = HT_CHAINED }, "chained");
+    test_snapshot((HTConfig){ .backend = HT_CHAINED, .cap_policy = HT_CAP_POW2, .incremental_rehash = true }, "incremental chained");
+    test_snapshot((HTConfig){ .backend = HT_SWISS }, "swiss");
+    test_snapshot((HTConfig){ .backend = HT_ROBIN_HOOD }, "robin hood");
+    test_frozen((HTConfig){ .backend = HT_CHAINED }, "chained");
+    test_frozen((HTConfig){ .backend = HT_SWISS }, "swiss");
+    test_frozen((HTConfig){ .backend = HT_ROBIN_HOOD }, "robin hood");
+    test_perfect((HTConfig){ .backend = HT_CHAINED }, "chained");
+    test_perfect((HTConfig){ .backend = HT_SWISS }, "swiss");
+    test_perfect((HTConfig){ .backend = HT_ROBIN_HOOD }, "robin hood");
+    test_get_or_insert((HTConfig){ .backend = HT_CHAINED }, "chained");
+    test_get_or_insert((HTConfig){ .backend = HT_CHAINED, .incremental_rehash = true }, "incremental chained");
+    test_get_or_insert((HTConfig){ .backend = HT_SWISS }, "swiss");
+    test_get_or_insert((HTConfig){ .backend = HT_ROBIN_HOOD }, "robin hood");
+    test_varlen_keys((HTConfig){ .backend = HT_CHAINED }, "chained");
+    test_varlen_keys((HTConfig){ .backend = HT_CHAINED, .cap_policy = HT_CAP_POW2, .incremental_rehash = true }, "incremental chained");
+    assert(_ht_create_with(HT_VARLEN_KEY, sizeof(int), &(HTConfig){ .backend = HT_SWISS }) == NULL);
+    test_specialized();
 
 
     printf("All tests passed successfully!\n");